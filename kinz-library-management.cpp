@@ -2,92 +2,596 @@
 #include <iomanip>
 #include <cctype>
 #include <string>
+#include <string_view>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cerrno>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LMS_POSIX 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define LMS_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+#ifdef __linux__
+#define LMS_SERVER 1
+#include <condition_variable>
+#include <csignal>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
 
 using namespace std;
 
-// Custom case-insensitive string comparison function
-bool caseInsensitiveCompare(const string& a, const string& b) {
-    if (a.length() != b.length()) {
-        return false;
+// ASCII lowercase of one character. Case-insensitive matching folds only
+// ASCII letters, as the C locale the program runs in does.
+constexpr char asciiLower(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// Case-folding kernels: the index of the first position where two strings
+// differ ignoring case (or length if they match), and in-place lowercasing.
+// The portable ones go a character at a time; on x86-64 the SSE2 ones go 16
+// characters at a time and the AVX2 ones 32.
+size_t foldedMismatchScalar(const char* a, const char* b, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        if (asciiLower(a[i]) != asciiLower(b[i])) {
+            return i;
+        }
+    }
+    return length;
+}
+
+void lowercaseScalar(char* text, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        text[i] = asciiLower(text[i]);
+    }
+}
+
+#ifdef LMS_X86_SIMD
+// Position of the first differing character in a non-zero compare mask
+inline size_t firstDifference(unsigned differences) {
+    return static_cast<size_t>(__builtin_ctz(differences));
+}
+
+// Lowercase 16 characters: 'A'..'Z' are shifted onto -128..-103, the only
+// bytes below -102 once shifted, and get their 0x20 bit set
+inline __m128i foldAscii(__m128i text) {
+    __m128i shifted = _mm_add_epi8(text, _mm_set1_epi8(static_cast<char>(0x80 - 'A')));
+    __m128i upper = _mm_cmplt_epi8(shifted, _mm_set1_epi8(-128 + 26));
+    return _mm_or_si128(text, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+// Bit i set where byte i of a and b differ once folded
+inline unsigned foldedDifferences(__m128i a, __m128i b) {
+    return ~static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(foldAscii(a), foldAscii(b)))) & 0xFFFF;
+}
+
+// The first and last 8 (or 4) characters of a string side by side,
+// overlapping in the middle when it is shorter than 16 (or 8)
+inline __m128i loadEnds64(const char* text, size_t length) {
+    return _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(text)),
+                              _mm_loadl_epi64(reinterpret_cast<const __m128i*>(text + length - 8)));
+}
+
+inline __m128i loadEnds32(const char* text, size_t length) {
+    int32_t head;
+    int32_t tail;
+    memcpy(&head, text, 4);
+    memcpy(&tail, text + length - 4, 4);
+    return _mm_unpacklo_epi32(_mm_cvtsi32_si128(head), _mm_cvtsi32_si128(tail));
+}
+
+// Strings shorter than a vector are compared through their two ends in one
+// register, so nothing past either string is read
+inline size_t foldedMismatchShort(const char* a, const char* b, size_t length) {
+    if (length >= 8) {
+        unsigned differences = foldedDifferences(loadEnds64(a, length), loadEnds64(b, length));
+        if (differences == 0) {
+            return length;
+        }
+        return (differences & 0xFF) != 0 ? firstDifference(differences) : length - 16 + firstDifference(differences);
+    }
+    if (length >= 4) {
+        unsigned differences = foldedDifferences(loadEnds32(a, length), loadEnds32(b, length)) & 0xFF;
+        if (differences == 0) {
+            return length;
+        }
+        return (differences & 0xF) != 0 ? firstDifference(differences) : length - 8 + firstDifference(differences);
+    }
+    return foldedMismatchScalar(a, b, length);
+}
+
+size_t foldedMismatchSse2(const char* a, const char* b, size_t length) {
+    if (length < 16) {
+        return foldedMismatchShort(a, b, length);
+    }
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        unsigned differences = foldedDifferences(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                                                 _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        if (differences != 0) {
+            return i + firstDifference(differences);
+        }
     }
+    if (i < length) {
+        // The last 16 characters, overlapping ones already found equal
+        i = length - 16;
+        unsigned differences = foldedDifferences(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                                                 _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        if (differences != 0) {
+            return i + firstDifference(differences);
+        }
+    }
+    return length;
+}
+
+void lowercaseSse2(char* text, size_t length) {
+    // Folding is idempotent, so the tail may overlap what was already done
+    if (length < 16) {
+        if (length < 8) {
+            lowercaseScalar(text, length);
+            return;
+        }
+        __m128i* tail = reinterpret_cast<__m128i*>(text + length - 8);
+        __m128i folded = foldAscii(_mm_loadl_epi64(tail));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(text), foldAscii(_mm_loadl_epi64(reinterpret_cast<__m128i*>(text))));
+        _mm_storel_epi64(tail, folded);
+        return;
+    }
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i* block = reinterpret_cast<__m128i*>(text + i);
+        _mm_storeu_si128(block, foldAscii(_mm_loadu_si128(block)));
+    }
+    if (i < length) {
+        __m128i* block = reinterpret_cast<__m128i*>(text + length - 16);
+        _mm_storeu_si128(block, foldAscii(_mm_loadu_si128(block)));
+    }
+}
+
+__attribute__((target("avx2"))) inline __m256i foldAscii(__m256i text) {
+    __m256i shifted = _mm256_add_epi8(text, _mm256_set1_epi8(static_cast<char>(0x80 - 'A')));
+    __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 26), shifted);
+    return _mm256_or_si256(text, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx2"))) size_t foldedMismatchAvx2(const char* a, const char* b, size_t length) {
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i x = foldAscii(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+        __m256i y = foldAscii(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        unsigned differences = ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)));
+        if (differences != 0) {
+            return i + firstDifference(differences);
+        }
+    }
+    // The SSE2 code finishing the tail is not VEX-encoded; clear the upper
+    // halves first so switching to it costs nothing
+    _mm256_zeroupper();
+    return i + foldedMismatchSse2(a + i, b + i, length - i);
+}
+
+__attribute__((target("avx2"))) void lowercaseAvx2(char* text, size_t length) {
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i* block = reinterpret_cast<__m256i*>(text + i);
+        _mm256_storeu_si256(block, foldAscii(_mm256_loadu_si256(block)));
+    }
+    _mm256_zeroupper();
+    lowercaseSse2(text + i, length - i);
+}
+#endif
+
+// The case-folding kernels for this CPU, picked once at startup
+struct CaseFoldKernels {
+    const char* name;
+    size_t (*mismatch)(const char* a, const char* b, size_t length);
+    void (*lowercase)(char* text, size_t length);
+};
+
+CaseFoldKernels selectCaseFoldKernels() {
+#ifdef LMS_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {"avx2", foldedMismatchAvx2, lowercaseAvx2};
+    }
+    return {"sse2", foldedMismatchSse2, lowercaseSse2};
+#else
+    return {"scalar", foldedMismatchScalar, lowercaseScalar};
+#endif
+}
+
+const CaseFoldKernels caseFold = selectCaseFoldKernels();
+
+// First position where a and b differ ignoring case, or length. Short
+// strings such as IDs skip the call through the kernel table.
+inline size_t foldedMismatch(const char* a, const char* b, size_t length) {
+#ifdef LMS_X86_SIMD
+    if (length < 16) {
+        return foldedMismatchShort(a, b, length);
+    }
+#endif
+    return caseFold.mismatch(a, b, length);
+}
+
+// Custom case-insensitive string comparison function
+bool caseInsensitiveCompare(string_view a, string_view b) {
+    return a.length() == b.length() && foldedMismatch(a.data(), b.data(), a.length()) == a.length();
+}
+
+// Custom function to convert string to lowercase
+string toLowercase(string str) {
+    caseFold.lowercase(&str[0], str.length());
+    return str;
+}
+
+// Trim spaces and tabs from both ends of a string
+string trimString(const string& str) {
+    size_t start = str.find_first_not_of(" \t");
+    if (start == string::npos) return "";
+    size_t end = str.find_last_not_of(" \t");
+    return str.substr(start, end - start + 1);
+}
+
+// Input validation rules shared by the prompts and bulk import
+bool isValidId(string_view id) {
+    if (id.empty()) return false;
     
-    for (size_t i = 0; i < a.length(); ++i) {
-        if (tolower(a[i]) != tolower(b[i])) {
+    for (char c : id) {
+        if (!isalnum(static_cast<unsigned char>(c))) {
             return false;
         }
     }
-    
     return true;
 }
 
-// Custom function to convert string to lowercase
-string toLowercase(string str) {
-    for (char& c : str) {
-        c = tolower(c);
+enum IsbnCheck { ISBN_OK, ISBN_BAD_CHARACTERS, ISBN_BAD_LENGTH };
+
+// An ISBN holds only digits and 'x', 10 or 13 characters in total
+IsbnCheck checkIsbn(string_view isbn) {
+    int digitCount = 0;
+    int xCount = 0;
+    
+    for (char c : isbn) {
+        if (isdigit(static_cast<unsigned char>(c))) {
+            digitCount++;
+        } else if (c == 'x' || c == 'X') {
+            xCount++;
+        } else {
+            return ISBN_BAD_CHARACTERS;
+        }
     }
-    return str;
+    
+    if (digitCount + xCount != 10 && digitCount + xCount != 13) {
+        return ISBN_BAD_LENGTH;
+    }
+    return ISBN_OK;
+}
+
+enum YearCheck { YEAR_OK, YEAR_NOT_FOUR_DIGITS, YEAR_OUT_OF_RANGE };
+
+// A publication year is 4 digits between 1000 and 2100
+YearCheck checkPublicationYear(string_view publication) {
+    if (publication.length() != 4) {
+        return YEAR_NOT_FOUR_DIGITS;
+    }
+    int year = 0;
+    for (char c : publication) {
+        if (!isdigit(static_cast<unsigned char>(c))) {
+            return YEAR_NOT_FOUR_DIGITS;
+        }
+        year = year * 10 + (c - '0');
+    }
+    
+    if (year < 1000 || year > 2100) {
+        return YEAR_OUT_OF_RANGE;
+    }
+    return YEAR_OK;
+}
+
+// Canonical ISBN-13 key used to match ISBNs. An ISBN-10 gets the 978 prefix
+// and the check digit is recomputed, so the ISBN-10 and ISBN-13 forms of a
+// book (or a mistyped check digit) give the same key. Anything that is not
+// a well-formed ISBN is matched as typed, ignoring case.
+string canonicalIsbn(string_view isbn) {
+    string key;
+    if (isbn.length() == 10) {
+        key = "978";
+        key.append(isbn.substr(0, 9));
+    } else if (isbn.length() == 13) {
+        key.assign(isbn.substr(0, 12));
+    }
+    for (char c : key) {
+        if (!isdigit(static_cast<unsigned char>(c))) {
+            key.clear();
+            break;
+        }
+    }
+    if (key.empty()) {
+        string raw(isbn);
+        for (char& c : raw) {
+            c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+        }
+        return raw;
+    }
+
+    int sum = 0;
+    for (size_t i = 0; i < 12; ++i) {
+        sum += (key[i] - '0') * (i % 2 == 0 ? 1 : 3);
+    }
+    key.push_back(static_cast<char>('0' + (10 - sum % 10) % 10));
+    return key;
+}
+
+// Check the ISBN-10 (mod 11, 'X' = 10 in last place) or ISBN-13 (mod 10) check digit
+bool isbnCheckDigitValid(const string& isbn) {
+    if (isbn.length() == 10) {
+        int sum = 0;
+        for (size_t i = 0; i < 10; ++i) {
+            int value;
+            if (isdigit(static_cast<unsigned char>(isbn[i]))) {
+                value = isbn[i] - '0';
+            } else if (i == 9 && (isbn[i] == 'x' || isbn[i] == 'X')) {
+                value = 10;
+            } else {
+                return false;
+            }
+            sum += value * static_cast<int>(10 - i);
+        }
+        return sum % 11 == 0;
+    }
+    if (isbn.length() == 13) {
+        int sum = 0;
+        for (size_t i = 0; i < 13; ++i) {
+            if (!isdigit(static_cast<unsigned char>(isbn[i]))) {
+                return false;
+            }
+            sum += (isbn[i] - '0') * (i % 2 == 0 ? 1 : 3);
+        }
+        return sum % 10 == 0;
+    }
+    return false;
+}
+
+// Case-insensitive three-way comparison of a and b. With prefixOnly, a is
+// cut to the length of b first, so every string starting with b is equal.
+int caseInsensitiveOrder(const char* a, size_t aLength, const char* b, size_t bLength, bool prefixOnly = false) {
+    if (prefixOnly && aLength > bLength) {
+        aLength = bLength;
+    }
+    size_t common = min(aLength, bLength);
+    size_t i = foldedMismatch(a, b, common);
+    if (i < common) {
+        unsigned char x = static_cast<unsigned char>(asciiLower(a[i]));
+        unsigned char y = static_cast<unsigned char>(asciiLower(b[i]));
+        return x < y ? -1 : 1;
+    }
+    return aLength == bLength ? 0 : aLength < bLength ? -1 : 1;
+}
+
+int caseInsensitiveOrder(string_view a, string_view b, bool prefixOnly = false) {
+    return caseInsensitiveOrder(a.data(), a.size(), b.data(), b.size(), prefixOnly);
+}
+
+// Year of a validated publication field
+int publicationYear(string_view publication) {
+    int year = 0;
+    for (char c : publication) {
+        if (!isdigit(static_cast<unsigned char>(c))) {
+            break;
+        }
+        year = year * 10 + (c - '0');
+    }
+    return year;
+}
+
+// Order editions by their leading number ("2nd" before "10th"), then by
+// the rest of the text. Editions without a number come last.
+int compareEditions(string_view a, string_view b, bool prefixOnly = false) {
+    size_t aDigits = 0;
+    size_t bDigits = 0;
+    while (aDigits < a.size() && isdigit(static_cast<unsigned char>(a[aDigits]))) {
+        ++aDigits;
+    }
+    while (bDigits < b.size() && isdigit(static_cast<unsigned char>(b[bDigits]))) {
+        ++bDigits;
+    }
+    if ((aDigits == 0) != (bDigits == 0)) {
+        return aDigits == 0 ? 1 : -1;
+    }
+    if (aDigits > 0) {
+        // Compare the numbers without converting them, ignoring leading zeros
+        size_t aStart = 0;
+        size_t bStart = 0;
+        while (aStart + 1 < aDigits && a[aStart] == '0') {
+            ++aStart;
+        }
+        while (bStart + 1 < bDigits && b[bStart] == '0') {
+            ++bStart;
+        }
+        if (aDigits - aStart != bDigits - bStart) {
+            return aDigits - aStart < bDigits - bStart ? -1 : 1;
+        }
+        int order = a.compare(aStart, aDigits - aStart, b, bStart, bDigits - bStart);
+        if (order != 0) {
+            return order < 0 ? -1 : 1;
+        }
+    }
+    return caseInsensitiveOrder(a.data() + aDigits, a.size() - aDigits,
+                                b.data() + bDigits, b.size() - bDigits, prefixOnly);
 }
 
+// Dynamic array of strings. Up to INLINE_CAPACITY strings are stored inside
+// the object itself, which covers the usual one to three authors per book
+// without touching the heap.
 class StringArray {
 private:
+    static const size_t INLINE_CAPACITY = 3;
+
     string* data;
     size_t size;
     size_t capacity;
-    
+    alignas(string) unsigned char inlineBuffer[INLINE_CAPACITY * sizeof(string)];
+
+    string* inlineData() {
+        return reinterpret_cast<string*>(inlineBuffer);
+    }
+
+    bool isInline() const {
+        return data == reinterpret_cast<const string*>(inlineBuffer);
+    }
+
+    // Destroy the elements and return to the empty inline buffer
+    void release() {
+        for (size_t i = 0; i < size; ++i) {
+            data[i].~string();
+        }
+        if (!isInline()) {
+            ::operator delete(data);
+        }
+        data = inlineData();
+        size = 0;
+        capacity = INLINE_CAPACITY;
+    }
+
+    // Take other's elements, stealing its heap buffer when it has one
+    void takeFrom(StringArray& other) {
+        if (other.isInline()) {
+            for (size_t i = 0; i < other.size; ++i) {
+                new (&data[i]) string(std::move(other.data[i]));
+                other.data[i].~string();
+            }
+            size = other.size;
+        } else {
+            data = other.data;
+            size = other.size;
+            capacity = other.capacity;
+            other.data = other.inlineData();
+            other.capacity = INLINE_CAPACITY;
+        }
+        other.size = 0;
+    }
+
+    // Move the elements into a heap buffer of newCapacity strings
+    void reallocate(size_t newCapacity) {
+        string* newData = static_cast<string*>(::operator new(newCapacity * sizeof(string)));
+        for (size_t i = 0; i < size; ++i) {
+            new (&newData[i]) string(std::move(data[i]));
+            data[i].~string();
+        }
+        if (!isInline()) {
+            ::operator delete(data);
+        }
+        data = newData;
+        capacity = newCapacity;
+    }
+
 public:
     // Constructor
-    StringArray() : data(nullptr), size(0), capacity(0) {}
+    StringArray() : data(inlineData()), size(0), capacity(INLINE_CAPACITY) {}
     
     // Copy constructor
-    StringArray(const StringArray& other) {
-        size = other.size;
-        capacity = other.capacity;
-        if (capacity > 0) {
-            data = new string[capacity];
-            for (size_t i = 0; i < size; ++i) {
-                data[i] = other.data[i];
-            }
-        } else {
-            data = nullptr;
+    StringArray(const StringArray& other) : StringArray() {
+        reserve(other.size);
+        for (size_t i = 0; i < other.size; ++i) {
+            new (&data[i]) string(other.data[i]);
         }
+        size = other.size;
+    }
+
+    // Move constructor
+    StringArray(StringArray&& other) noexcept : StringArray() {
+        takeFrom(other);
     }
     
     // Assignment operator
     StringArray& operator=(const StringArray& other) {
         if (this != &other) {
-            delete[] data;
-            size = other.size;
-            capacity = other.capacity;
-            if (capacity > 0) {
-                data = new string[capacity];
-                for (size_t i = 0; i < size; ++i) {
-                    data[i] = other.data[i];
+            size_t common = size < other.size ? size : other.size;
+            for (size_t i = 0; i < common; ++i) {
+                data[i] = other.data[i];
+            }
+            for (size_t i = other.size; i < size; ++i) {
+                data[i].~string();
+            }
+            if (other.size > size) {
+                reserve(other.size);
+                for (size_t i = size; i < other.size; ++i) {
+                    new (&data[i]) string(other.data[i]);
                 }
-            } else {
-                data = nullptr;
             }
+            size = other.size;
+        }
+        return *this;
+    }
+
+    // Move assignment operator
+    StringArray& operator=(StringArray&& other) noexcept {
+        if (this != &other) {
+            release();
+            takeFrom(other);
         }
         return *this;
     }
     
     // Destructor
     ~StringArray() {
-        delete[] data;
+        release();
+    }
+
+    // Make room for at least newCapacity elements
+    void reserve(size_t newCapacity) {
+        if (newCapacity > capacity) {
+            reallocate(newCapacity);
+        }
+    }
+
+    // Construct an element in place at the end
+    template <typename... Args>
+    string& emplace_back(Args&&... args) {
+        if (size >= capacity) {
+            // Build the new element first, since args may refer to an element
+            string value(std::forward<Args>(args)...);
+            reallocate(capacity * 2);
+            new (&data[size]) string(std::move(value));
+        } else {
+            new (&data[size]) string(std::forward<Args>(args)...);
+        }
+        return data[size++];
     }
     
     // Add an element
     void push_back(const string& value) {
-        if (size >= capacity) {
-            size_t newCapacity = capacity == 0 ? 1 : capacity * 2;
-            string* newData = new string[newCapacity];
-            for (size_t i = 0; i < size; ++i) {
-                newData[i] = data[i];
-            }
-            delete[] data;
-            data = newData;
-            capacity = newCapacity;
-        }
-        data[size++] = value;
+        emplace_back(value);
+    }
+
+    void push_back(string&& value) {
+        emplace_back(std::move(value));
     }
     
     // Access element
@@ -109,672 +613,7557 @@ public:
     bool empty() const {
         return size == 0;
     }
+
+    // Range over the elements
+    const string* begin() const {
+        return data;
+    }
+
+    const string* end() const {
+        return data + size;
+    }
 };
 
-class Book {
+// Dynamic array for small values such as slots, line numbers and offsets
+template <typename T>
+class DynamicArray {
 private:
-    string id;
-    string isbn;
-    string title;
-    StringArray authors;
-    string edition;
-    string publication;
-    string category;
+    T* data;
+    size_t size;
+    size_t capacity;
+
+    void reallocate(size_t newCapacity) {
+        T* newData = new T[newCapacity];
+        for (size_t i = 0; i < size; ++i) {
+            newData[i] = std::move(data[i]);
+        }
+        delete[] data;
+        data = newData;
+        capacity = newCapacity;
+    }
 
 public:
-    // Constructors
-    Book() {}
-    Book(const string& id, const string& isbn, const string& title,
-         const StringArray& authors, const string& edition,
-         const string& publication, const string& category)
-        : id(id), isbn(isbn), title(title), authors(authors), 
-          edition(edition), publication(publication), category(category) {}
-
-    // Getter methods
-    string getId() const { return id; }
-    string getValidIsbn() const { return isbn; }
-    string getTitle() const { return title; }
-    StringArray getAuthors() const { return authors; }
-    string getAuthorsAsString() const {
-        string result = "";
-        for (size_t i = 0; i < authors.length(); ++i) {
-            result += authors[i];
-            if (i < authors.length() - 1) {
-                result += ", ";
+    // Constructor
+    DynamicArray() : data(nullptr), size(0), capacity(0) {}
+
+    // Copy constructor
+    DynamicArray(const DynamicArray& other) : data(nullptr), size(0), capacity(0) {
+        *this = other;
+    }
+
+    // Move constructor
+    DynamicArray(DynamicArray&& other) noexcept
+        : data(other.data), size(other.size), capacity(other.capacity) {
+        other.data = nullptr;
+        other.size = 0;
+        other.capacity = 0;
+    }
+
+    // Assignment operator
+    DynamicArray& operator=(const DynamicArray& other) {
+        if (this != &other) {
+            clear();
+            reserve(other.size);
+            for (size_t i = 0; i < other.size; ++i) {
+                data[i] = other.data[i];
             }
+            size = other.size;
         }
-        return result;
+        return *this;
     }
-    string getEdition() const { return edition; }
-    string getPublication() const { return publication; }
-    string getCategory() const { return category; }
 
-    // Setter methods (excluding ID)
-    void setIsbn(const string& newIsbn) { isbn = newIsbn; }
-    void setTitle(const string& newTitle) { title = newTitle; }
-    void setAuthors(const StringArray& newAuthors) { authors = newAuthors; }
-    void setEdition(const string& newEdition) { edition = newEdition; }
-    void setPublication(const string& newPublication) { publication = newPublication; }
-    void setCategory(const string& newCategory) { category = newCategory; }
-};
+    // Move assignment operator
+    DynamicArray& operator=(DynamicArray&& other) noexcept {
+        if (this != &other) {
+            delete[] data;
+            data = other.data;
+            size = other.size;
+            capacity = other.capacity;
+            other.data = nullptr;
+            other.size = 0;
+            other.capacity = 0;
+        }
+        return *this;
+    }
 
-class LibraryManagementSystem {
-private:
-    static const int MAX_BOOKS = 100;
-    Book books[MAX_BOOKS];
-    int bookCount;
-    string categories[2] = {"Fiction", "Non-fiction"};
-    static const int MAX_CATEGORIES = 2;
+    // Destructor
+    ~DynamicArray() {
+        delete[] data;
+    }
 
-    // Input Validation Methods 
-    bool isValidId(const string& id) const {
-        if (id.empty()) return false;
-        
-        for (char c : id) {
-            if (!isalnum(c)) {
-                return false;
-            }
+    // Make room for at least newCapacity elements
+    void reserve(size_t newCapacity) {
+        if (newCapacity > capacity) {
+            reallocate(newCapacity);
         }
-        return true;
     }
 
-    bool isIdUnique(const string& id) const {
-        for (int i = 0; i < bookCount; ++i) {
-            if (caseInsensitiveCompare(books[i].getId(), id)) {
-                return false;
-            }
+    // Add an element
+    void push_back(const T& value) {
+        if (size >= capacity) {
+            T copy = value;
+            reallocate(capacity == 0 ? 4 : capacity * 2);
+            data[size++] = std::move(copy);
+        } else {
+            data[size++] = value;
         }
-        return true;
     }
 
-    bool isValidCategory(const string& category) const {
-        string normalizedCategory = category;
-        // Replace "non fiction" with "non-fiction" for comparison
-        if (toLowercase(normalizedCategory) == "non fiction") {
-            normalizedCategory = "Non-fiction";
+    void push_back(T&& value) {
+        if (size >= capacity) {
+            reallocate(capacity == 0 ? 4 : capacity * 2);
         }
-        
-        for (int i = 0; i < MAX_CATEGORIES; ++i) {
-            if (caseInsensitiveCompare(categories[i], normalizedCategory)) {
-                return true;
+        data[size++] = std::move(value);
+    }
+
+    // Remove the last element
+    void pop_back() {
+        --size;
+    }
+
+    // Grow or shrink to newSize elements, filling new ones with value
+    void resize(size_t newSize, const T& value = T()) {
+        if (newSize > capacity) {
+            size_t newCapacity = capacity == 0 ? 4 : capacity;
+            while (newCapacity < newSize) {
+                newCapacity *= 2;
             }
+            reallocate(newCapacity);
         }
-        return false;
+        for (size_t i = size; i < newSize; ++i) {
+            data[i] = value;
+        }
+        size = newSize;
     }
 
-    string trimString(const string& str) {
-        size_t start = str.find_first_not_of(" \t");
-        if (start == string::npos) return "";
-        size_t end = str.find_last_not_of(" \t");
-        return str.substr(start, end - start + 1);
+    // Remove every element but keep the allocated space
+    void clear() {
+        size = 0;
     }
 
-    string getValidIsbn() {
+    // Access element
+    T& operator[](size_t index) {
+        return data[index];
+    }
+
+    // Const access element
+    const T& operator[](size_t index) const {
+        return data[index];
+    }
+
+    // Get size
+    size_t length() const {
+        return size;
+    }
+
+    // Check if empty
+    bool empty() const {
+        return size == 0;
+    }
+
+    // Range over the elements
+    T* begin() {
+        return data;
+    }
+
+    T* end() {
+        return data + size;
+    }
+
+    const T* begin() const {
+        return data;
+    }
+
+    const T* end() const {
+        return data + size;
+    }
+};
+
+// Case-insensitive FNV-1a hash, consistent with caseInsensitiveCompare
+size_t caseInsensitiveHash(string_view str) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : str) {
+        hash ^= static_cast<unsigned char>(asciiLower(c));
+        hash *= 1099511628211ULL;
+    }
+    return static_cast<size_t>(hash);
+}
+
+// Exact FNV-1a hash of a string
+size_t stringHash(string_view str) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : str) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return static_cast<size_t>(hash);
+}
+
+// Bump allocator for packed book text. Blocks are carved out of large slabs
+// and only given back all at once, so filling a catalog costs one allocation
+// per slab and emptying it frees each slab however many books it held.
+class TextArena {
+private:
+    static const size_t SLAB_SIZE = 1 << 20;
+
+    DynamicArray<char*> slabs;
+    char* next;
+    size_t left;
+    size_t used;
+
+public:
+    // Constructor
+    TextArena() : next(nullptr), left(0), used(0) {}
+
+    TextArena(const TextArena&) = delete;
+    TextArena& operator=(const TextArena&) = delete;
+
+    // Move constructor
+    TextArena(TextArena&& other) noexcept
+        : slabs(std::move(other.slabs)), next(other.next), left(other.left), used(other.used) {
+        other.next = nullptr;
+        other.left = 0;
+        other.used = 0;
+    }
+
+    // Move assignment operator
+    TextArena& operator=(TextArena&& other) noexcept {
+        if (this != &other) {
+            release();
+            slabs = std::move(other.slabs);
+            next = other.next;
+            left = other.left;
+            used = other.used;
+            other.next = nullptr;
+            other.left = 0;
+            other.used = 0;
+        }
+        return *this;
+    }
+
+    // Destructor
+    ~TextArena() {
+        release();
+    }
+
+    // Carve out a block of at least bytes, aligned for uint32_t
+    void* allocate(size_t bytes) {
+        bytes = (bytes + 3) & ~static_cast<size_t>(3);
+        if (bytes > left) {
+            size_t slabSize = bytes > SLAB_SIZE ? bytes : SLAB_SIZE;
+            next = static_cast<char*>(::operator new(slabSize));
+            slabs.push_back(next);
+            left = slabSize;
+        }
+        void* block = next;
+        next += bytes;
+        left -= bytes;
+        used += bytes;
+        return block;
+    }
+
+    // Give every slab back; blocks handed out before are no longer valid
+    void release() {
+        for (char* slab : slabs) {
+            ::operator delete(slab);
+        }
+        slabs.clear();
+        next = nullptr;
+        left = 0;
+        used = 0;
+    }
+
+    // Bytes handed out since the last release
+    size_t bytesUsed() const {
+        return used;
+    }
+};
+
+// Pool of interned strings for the book fields that repeat across a
+// catalog: editions, categories and author names. Each distinct text gets a
+// small integer handle, so a book stores four bytes per such field and two
+// fields are equal exactly when their handles are. Text is never moved or
+// dropped once added, so any thread can resolve a handle it was given
+// without locking. Adding text takes a lock; each thread caches the handles
+// of recently interned strings, so repeated values usually skip it.
+//
+// As nothing is dropped, the pool holds every distinct value seen since
+// the catalog was loaded, including ones edits have since replaced, and
+// only a restart after a checkpoint gives unused text back. Changes call
+// hasRoomFor() first and are refused once the pool reaches MAX_VALUES
+// values or MAX_TEXT_BYTES of text, so a long-running server stays within
+// those limits however much is edited.
+class InternTable {
+public:
+    // Handle of the empty string
+    static constexpr uint32_t EMPTY = 0;
+
+private:
+    static constexpr uint32_t FREE_CELL = 0xFFFFFFFF;
+    static const size_t CHUNK_BITS = 12;
+    static const size_t CHUNK_SIZE = static_cast<size_t>(1) << CHUNK_BITS;
+    static const size_t MAX_CHUNKS = static_cast<size_t>(1) << 14;
+    static const size_t MIN_CAPACITY = 1024;
+    static const size_t CACHE_SIZE = 256;
+    // Limits for changes, below the hard limit on handles so that loading a
+    // catalog never runs into them
+    static const size_t MAX_VALUES = MAX_CHUNKS * CHUNK_SIZE / 2;
+    static const size_t MAX_TEXT_BYTES = static_cast<size_t>(1) << 30;
+
+    struct CacheEntry {
+        const InternTable* owner;
+        size_t hash;
+        uint32_t handle;
+    };
+
+    // Texts by handle, in chunks that are allocated once and never move
+    string_view* chunks[MAX_CHUNKS];
+    uint32_t count;
+    // Open-addressing table of handles by text hash, with the hash of
+    // each handle kept for rehashing
+    uint32_t* table;
+    size_t capacity;
+    DynamicArray<size_t> hashes;
+    TextArena storage;
+    mutex lock;
+    // Values and bytes of text interned, readable without the lock
+    atomic<size_t> valuesUsed;
+    atomic<size_t> bytesUsed;
+
+    void rehash(size_t newCapacity) {
+        delete[] table;
+        table = new uint32_t[newCapacity];
+        capacity = newCapacity;
+        for (size_t i = 0; i < capacity; ++i) {
+            table[i] = FREE_CELL;
+        }
+        for (uint32_t handle = 0; handle < count; ++handle) {
+            size_t pos = hashes[handle] & (capacity - 1);
+            while (table[pos] != FREE_CELL) {
+                pos = (pos + 1) & (capacity - 1);
+            }
+            table[pos] = handle;
+        }
+    }
+
+    // Table position holding value, or the empty cell where it would go
+    size_t probe(string_view value, size_t hash) const {
+        size_t pos = hash & (capacity - 1);
+        while (table[pos] != FREE_CELL && (hashes[table[pos]] != hash || text(table[pos]) != value)) {
+            pos = (pos + 1) & (capacity - 1);
+        }
+        return pos;
+    }
+
+    // Handle of value, adding it if it is new; the lock must be held
+    uint32_t insert(string_view value, size_t hash) {
+        if ((static_cast<size_t>(count) + 1) * 4 > capacity * 3) {
+            rehash(capacity * 2);
+        }
+        size_t pos = probe(value, hash);
+        if (table[pos] != FREE_CELL) {
+            return table[pos];
+        }
+        if (count == MAX_CHUNKS * CHUNK_SIZE) {
+            throw bad_alloc();
+        }
+        char* copy = static_cast<char*>(storage.allocate(value.size()));
+        if (!value.empty()) {
+            memcpy(copy, value.data(), value.size());
+        }
+        size_t chunk = count >> CHUNK_BITS;
+        if (chunks[chunk] == nullptr) {
+            chunks[chunk] = new string_view[CHUNK_SIZE];
+        }
+        chunks[chunk][count & (CHUNK_SIZE - 1)] = string_view(copy, value.size());
+        hashes.push_back(hash);
+        table[pos] = count;
+        valuesUsed.store(count + 1, memory_order_relaxed);
+        bytesUsed.store(bytesUsed.load(memory_order_relaxed) + value.size(), memory_order_relaxed);
+        return count++;
+    }
+
+public:
+    // Constructor
+    InternTable() : count(0), table(nullptr), capacity(0), valuesUsed(0), bytesUsed(0) {
+        for (size_t i = 0; i < MAX_CHUNKS; ++i) {
+            chunks[i] = nullptr;
+        }
+        rehash(MIN_CAPACITY);
+        insert(string_view(), stringHash(string_view()));
+    }
+
+    InternTable(const InternTable&) = delete;
+    InternTable& operator=(const InternTable&) = delete;
+
+    // Destructor
+    ~InternTable() {
+        for (size_t i = 0; i < MAX_CHUNKS && chunks[i] != nullptr; ++i) {
+            delete[] chunks[i];
+        }
+        delete[] table;
+    }
+
+    // Handle of value, interning it if it is new
+    uint32_t intern(string_view value) {
+        static thread_local CacheEntry cache[CACHE_SIZE];
+        size_t hash = stringHash(value);
+        CacheEntry& cached = cache[hash % CACHE_SIZE];
+        if (cached.owner == this && cached.hash == hash && text(cached.handle) == value) {
+            return cached.handle;
+        }
+        uint32_t handle;
+        {
+            lock_guard<mutex> guard(lock);
+            handle = insert(value, hash);
+        }
+        cached = CacheEntry{this, hash, handle};
+        return handle;
+    }
+
+    // Text of a handle
+    string_view text(uint32_t handle) const {
+        return chunks[handle >> CHUNK_BITS][handle & (CHUNK_SIZE - 1)];
+    }
+
+    // Whether the values not interned yet would stay within the limits for
+    // changes. Only near the limits does this take the lock to find out
+    // which values are new.
+    bool hasRoomFor(const string_view* values, size_t valueCount) {
+        size_t bytes = 0;
+        for (size_t i = 0; i < valueCount; ++i) {
+            bytes += values[i].size();
+        }
+        if (valuesUsed.load(memory_order_relaxed) + valueCount <= MAX_VALUES
+            && bytesUsed.load(memory_order_relaxed) + bytes <= MAX_TEXT_BYTES) {
+            return true;
+        }
+        lock_guard<mutex> guard(lock);
+        size_t newValues = 0;
+        size_t newBytes = 0;
+        for (size_t i = 0; i < valueCount; ++i) {
+            if (table[probe(values[i], stringHash(values[i]))] == FREE_CELL) {
+                ++newValues;
+                newBytes += values[i].size();
+            }
+        }
+        return count + newValues <= MAX_VALUES && bytesUsed.load(memory_order_relaxed) + newBytes <= MAX_TEXT_BYTES;
+    }
+};
+
+// Interned editions, categories and author names of every book
+InternTable bookStrings;
+
+// Case-folded FNV-1a hash of a category name. It is constexpr so the
+// compiler can lay out the built-in table below.
+constexpr uint64_t categoryHash(string_view name) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : name) {
+        hash ^= static_cast<unsigned char>(asciiLower(c));
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Slot of a hashed category name in a table of mask + 1 slots under seed
+constexpr size_t categorySlot(uint64_t hash, uint32_t seed, size_t mask) {
+    uint64_t mixed = hash ^ (static_cast<uint64_t>(seed) * 0x9E3779B97F4A7C15ULL);
+    mixed ^= mixed >> 31;
+    mixed *= 0xBF58476D1CE4E5B9ULL;
+    mixed ^= mixed >> 29;
+    return static_cast<size_t>(mixed) & mask;
+}
+
+// The built-in categories and every spelling accepted for them. The first
+// BUILTIN_CATEGORY_COUNT keys are the canonical names, in code order.
+constexpr string_view BUILTIN_CATEGORY_KEYS[] = {"Fiction", "Non-fiction", "non fiction"};
+constexpr int BUILTIN_CATEGORY_CODES[] = {0, 1, 1};
+constexpr size_t BUILTIN_CATEGORY_COUNT = 2;
+constexpr size_t BUILTIN_CATEGORY_KEY_COUNT = sizeof(BUILTIN_CATEGORY_CODES) / sizeof(BUILTIN_CATEGORY_CODES[0]);
+constexpr size_t BUILTIN_CATEGORY_SLOTS = 4;
+
+// Perfect hash of the built-in keys: a seed under which each key has a slot
+// of its own, and the key in each slot (or -1)
+struct BuiltinCategoryTable {
+    uint32_t seed;
+    int keys[BUILTIN_CATEGORY_SLOTS];
+};
+
+constexpr BuiltinCategoryTable placeBuiltinCategories() {
+    for (uint32_t seed = 0;; ++seed) {
+        BuiltinCategoryTable table{seed, {}};
+        for (size_t slot = 0; slot < BUILTIN_CATEGORY_SLOTS; ++slot) {
+            table.keys[slot] = -1;
+        }
+        bool placed = true;
+        for (size_t i = 0; i < BUILTIN_CATEGORY_KEY_COUNT && placed; ++i) {
+            size_t slot = categorySlot(categoryHash(BUILTIN_CATEGORY_KEYS[i]), seed, BUILTIN_CATEGORY_SLOTS - 1);
+            placed = table.keys[slot] < 0;
+            table.keys[slot] = static_cast<int>(i);
+        }
+        if (placed) {
+            return table;
+        }
+    }
+}
+
+constexpr BuiltinCategoryTable BUILTIN_CATEGORY_TABLE = placeBuiltinCategories();
+
+// The categories a book may be filed under. Without a taxonomy file these
+// are the built-in Fiction and Non-fiction, matched through the table the
+// compiler laid out above. A loaded taxonomy is a tree of any number of
+// categories with aliases, matched through a perfect hash built as it is
+// loaded. Either way a name is looked up with one hash and one comparison.
+// Codes are given in preorder, so a category and everything under it are
+// the codes [code, lastCode(code)].
+class CategoryTaxonomy {
+public:
+    // Codes from here up are kept free for the store's column markers
+    static const size_t MAX_CATEGORIES = 0xFFF0;
+
+private:
+    static constexpr uint32_t NO_KEY = 0xFFFFFFFF;
+    static const size_t KEYS_PER_BUCKET = 4;
+    static const uint32_t MAX_SEED = 1 << 16;
+
+    bool builtIn;
+    // Canonical name and last descendant of each category, by code
+    DynamicArray<string> names;
+    DynamicArray<int> lastCodes;
+    // Perfect hash of every name and alias of a loaded taxonomy: the bucket
+    // of a key gives the seed that puts it in a slot of its own
+    DynamicArray<string> keys;
+    DynamicArray<int> keyCodes;
+    DynamicArray<uint32_t> seeds;
+    DynamicArray<uint32_t> slots;
+    // Code of each category by the bookStrings handle of its name
+    DynamicArray<int> codesByHandle;
+
+    size_t bucketOf(uint64_t hash) const {
+        return static_cast<size_t>(hash >> 32) % seeds.length();
+    }
+
+    // Pick a seed for every bucket, largest buckets first while the table
+    // is emptiest. Returns false if some bucket found no seed.
+    bool placeKeys(size_t slotCount) {
+        size_t bucketCount = (keys.length() + KEYS_PER_BUCKET - 1) / KEYS_PER_BUCKET;
+        seeds.clear();
+        seeds.resize(bucketCount, 0);
+        slots.clear();
+        slots.resize(slotCount, NO_KEY);
+
+        DynamicArray<uint64_t> hashes;
+        DynamicArray<size_t> starts;
+        DynamicArray<uint32_t> members;
+        starts.resize(bucketCount + 1, 0);
+        members.resize(keys.length());
+        for (size_t i = 0; i < keys.length(); ++i) {
+            hashes.push_back(categoryHash(keys[i]));
+            ++starts[bucketOf(hashes[i]) + 1];
+        }
+        for (size_t bucket = 0; bucket < bucketCount; ++bucket) {
+            starts[bucket + 1] += starts[bucket];
+        }
+        DynamicArray<size_t> filled = starts;
+        for (size_t i = 0; i < keys.length(); ++i) {
+            members[filled[bucketOf(hashes[i])]++] = static_cast<uint32_t>(i);
+        }
+        DynamicArray<size_t> order;
+        for (size_t bucket = 0; bucket < bucketCount; ++bucket) {
+            order.push_back(bucket);
+        }
+        sort(order.begin(), order.end(), [&starts](size_t a, size_t b) {
+            return starts[a + 1] - starts[a] > starts[b + 1] - starts[b];
+        });
+
+        for (size_t bucket : order) {
+            size_t first = starts[bucket];
+            size_t last = starts[bucket + 1];
+            uint32_t seed = 0;
+            for (; seed < MAX_SEED; ++seed) {
+                size_t placed = first;
+                for (; placed < last; ++placed) {
+                    size_t slot = categorySlot(hashes[members[placed]], seed, slotCount - 1);
+                    if (slots[slot] != NO_KEY) {
+                        break;
+                    }
+                    slots[slot] = members[placed];
+                }
+                if (placed == last) {
+                    break;
+                }
+                for (size_t i = first; i < placed; ++i) {
+                    slots[categorySlot(hashes[members[i]], seed, slotCount - 1)] = NO_KEY;
+                }
+            }
+            if (seed == MAX_SEED) {
+                return false;
+            }
+            seeds[bucket] = seed;
+        }
+        return true;
+    }
+
+    void mapHandles() {
+        codesByHandle.clear();
+        for (size_t code = 0; code < names.length(); ++code) {
+            uint32_t handle = bookStrings.intern(names[code]);
+            if (handle >= codesByHandle.length()) {
+                codesByHandle.resize(static_cast<size_t>(handle) + 1, -1);
+            }
+            codesByHandle[handle] = static_cast<int>(code);
+        }
+    }
+
+public:
+    // Constructor: the built-in categories
+    CategoryTaxonomy() : builtIn(true) {
+        for (size_t code = 0; code < BUILTIN_CATEGORY_COUNT; ++code) {
+            names.push_back(string(BUILTIN_CATEGORY_KEYS[code]));
+            lastCodes.push_back(static_cast<int>(code));
+        }
+        mapHandles();
+    }
+
+    // Replace the categories with a taxonomy read from text, one category
+    // a line:
+    //   NAME|PARENT|ALIAS;ALIAS...
+    // PARENT is a name or alias from an earlier line; it and the aliases may
+    // be left out. Blank lines and lines starting with '#' are skipped.
+    // Returns false, with the categories unchanged, if the text is malformed.
+    bool load(string_view text, string& error) {
+        DynamicArray<string> entryNames;
+        DynamicArray<int> entryParents;
+        DynamicArray<size_t> entryLines;
+        DynamicArray<string> newKeys;
+        DynamicArray<int> keyEntries;
+        // Keys read so far by hash, for finding parents and duplicates
+        DynamicArray<uint32_t> seen;
+        seen.resize(64, NO_KEY);
+        auto probe = [&](string_view key) {
+            size_t pos = static_cast<size_t>(categoryHash(key)) & (seen.length() - 1);
+            while (seen[pos] != NO_KEY && !caseInsensitiveCompare(newKeys[seen[pos]], key)) {
+                pos = (pos + 1) & (seen.length() - 1);
+            }
+            return pos;
+        };
+        auto addKey = [&](const string& key, size_t line) {
+            size_t pos = probe(key);
+            if (seen[pos] != NO_KEY) {
+                error = "line " + to_string(line) + ": '" + key + "' is already defined";
+                return false;
+            }
+            seen[pos] = static_cast<uint32_t>(newKeys.length());
+            newKeys.push_back(key);
+            keyEntries.push_back(static_cast<int>(entryNames.length() - 1));
+            if (newKeys.length() * 2 > seen.length()) {
+                size_t grown = seen.length() * 2;
+                seen.clear();
+                seen.resize(grown, NO_KEY);
+                for (size_t i = 0; i < newKeys.length(); ++i) {
+                    seen[probe(newKeys[i])] = static_cast<uint32_t>(i);
+                }
+            }
+            return true;
+        };
+
+        size_t line = 0;
+        for (size_t pos = 0; pos < text.size();) {
+            size_t end = text.find('\n', pos);
+            if (end == string_view::npos) {
+                end = text.size();
+            }
+            string record(text.substr(pos, end - pos));
+            pos = end + 1;
+            ++line;
+            if (!record.empty() && record.back() == '\r') {
+                record.pop_back();
+            }
+            record = trimString(record);
+            if (record.empty() || record[0] == '#') {
+                continue;
+            }
+
+            size_t bar = record.find('|');
+            size_t secondBar = bar == string::npos ? string::npos : record.find('|', bar + 1);
+            if (secondBar != string::npos && record.find('|', secondBar + 1) != string::npos) {
+                error = "line " + to_string(line) + ": expected NAME|PARENT|ALIASES";
+                return false;
+            }
+            string name = trimString(record.substr(0, bar));
+            string parent = bar == string::npos ? "" : trimString(record.substr(bar + 1, secondBar - bar - 1));
+            string aliases = secondBar == string::npos ? "" : record.substr(secondBar + 1);
+            if (name.empty()) {
+                error = "line " + to_string(line) + ": category name is empty";
+                return false;
+            }
+            if (entryNames.length() == MAX_CATEGORIES) {
+                error = "line " + to_string(line) + ": more than " + to_string(MAX_CATEGORIES) + " categories";
+                return false;
+            }
+            int parentEntry = -1;
+            if (!parent.empty()) {
+                size_t found = probe(parent);
+                if (seen[found] == NO_KEY) {
+                    error = "line " + to_string(line) + ": parent '" + parent + "' is not defined on an earlier line";
+                    return false;
+                }
+                parentEntry = keyEntries[seen[found]];
+            }
+            entryNames.push_back(name);
+            entryParents.push_back(parentEntry);
+            entryLines.push_back(line);
+            if (!addKey(name, line)) {
+                return false;
+            }
+            for (size_t start = 0; start <= aliases.size();) {
+                size_t semicolon = aliases.find(';', start);
+                if (semicolon == string::npos) {
+                    semicolon = aliases.size();
+                }
+                string alias = trimString(aliases.substr(start, semicolon - start));
+                start = semicolon + 1;
+                if (!alias.empty() && !addKey(alias, line)) {
+                    return false;
+                }
+            }
+        }
+        if (entryNames.empty()) {
+            error = "no categories defined";
+            return false;
+        }
+
+        // Number the tree in preorder. Children follow their parent in the
+        // file, so subtree sizes add up from the last line back, and each
+        // category's code is where the previous sibling's subtree ended.
+        size_t count = entryNames.length();
+        DynamicArray<int> sizes;
+        sizes.resize(count, 1);
+        for (size_t i = count; i-- > 0;) {
+            if (entryParents[i] >= 0) {
+                sizes[static_cast<size_t>(entryParents[i])] += sizes[i];
+            }
+        }
+        DynamicArray<int> codes;
+        DynamicArray<int> nextChild;
+        codes.resize(count);
+        nextChild.resize(count);
+        int nextRoot = 0;
+        for (size_t i = 0; i < count; ++i) {
+            int& next = entryParents[i] < 0 ? nextRoot : nextChild[static_cast<size_t>(entryParents[i])];
+            codes[i] = next;
+            next += sizes[i];
+            nextChild[i] = codes[i] + 1;
+        }
+
+        builtIn = false;
+        names.clear();
+        names.resize(count);
+        lastCodes.clear();
+        lastCodes.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            size_t code = static_cast<size_t>(codes[i]);
+            names[code] = std::move(entryNames[i]);
+            lastCodes[code] = codes[i] + sizes[i] - 1;
+        }
+        keys = std::move(newKeys);
+        keyCodes.clear();
+        for (size_t i = 0; i < keys.length(); ++i) {
+            keyCodes.push_back(codes[static_cast<size_t>(keyEntries[i])]);
+        }
+        size_t slotCount = 4;
+        while (slotCount * 3 < keys.length() * 4) {
+            slotCount *= 2;
+        }
+        while (!placeKeys(slotCount)) {
+            slotCount *= 2;
+        }
+        mapHandles();
+        return true;
+    }
+
+    // Code of a category name or alias in any case, or -1
+    int find(string_view name) const {
+        uint64_t hash = categoryHash(name);
+        if (builtIn) {
+            int key = BUILTIN_CATEGORY_TABLE.keys[categorySlot(hash, BUILTIN_CATEGORY_TABLE.seed, BUILTIN_CATEGORY_SLOTS - 1)];
+            return key >= 0 && caseInsensitiveCompare(BUILTIN_CATEGORY_KEYS[key], name) ? BUILTIN_CATEGORY_CODES[key] : -1;
+        }
+        uint32_t key = slots[categorySlot(hash, seeds[bucketOf(hash)], slots.length() - 1)];
+        return key != NO_KEY && caseInsensitiveCompare(keys[key], name) ? keyCodes[key] : -1;
+    }
+
+    // Code of an interned category, or -1. Books keep their category in
+    // canonical spelling, so this is normally one array lookup.
+    int codeOfHandle(uint32_t handle) const {
+        if (handle < codesByHandle.length() && codesByHandle[handle] >= 0) {
+            return codesByHandle[handle];
+        }
+        return find(bookStrings.text(handle));
+    }
+
+    // Canonical name of a category
+    const string& name(int code) const {
+        return names[static_cast<size_t>(code)];
+    }
+
+    // Last code under a category; equal to code for a category with no children
+    int lastCode(int code) const {
+        return lastCodes[static_cast<size_t>(code)];
+    }
+
+    // Number of categories
+    size_t length() const {
+        return names.length();
+    }
+
+    // Check if these are the built-in categories
+    bool isBuiltIn() const {
+        return builtIn;
+    }
+};
+
+// Categories books may be filed under; see --categories
+CategoryTaxonomy bookCategories;
+
+// Code of a category name or alias, or -1
+int categoryCode(string_view category) {
+    return bookCategories.find(category);
+}
+
+// Match a category name or alias case-insensitively, and give back the
+// category's canonical spelling
+bool normalizeCategory(string_view category, string& canonical) {
+    int code = bookCategories.find(category);
+    if (code < 0) {
+        return false;
+    }
+    canonical = bookCategories.name(code);
+    return true;
+}
+
+// Code of an interned category, or -1
+int categoryCodeOf(uint32_t category) {
+    return bookCategories.codeOfHandle(category);
+}
+
+// A book keeps its fields in one block. Editions, categories and authors
+// repeat across books and are stored as bookStrings handles; the other
+// fields are text. The block holds the number of authors, the edition,
+// category and author handles, the end offsets of the id, ISBN, title and
+// publication, then their characters back to back. A book on its own owns
+// a heap block; a book in the store points into the store's TextArena.
+class Book {
+public:
+    // Fields ahead of the authors in a catalog file record, the order in
+    // which books are built from a list of fields
+    static const size_t FIXED_FIELDS = 6;
+
+    // The authors of a book, read from its block
+    class AuthorList {
+    private:
+        const Book& book;
+
+    public:
+        class Iterator {
+        private:
+            const Book* book;
+            size_t index;
+
+        public:
+            Iterator(const Book* owner, size_t position) : book(owner), index(position) {}
+            string_view operator*() const { return bookStrings.text(book->authorHandle(index)); }
+            Iterator& operator++() {
+                ++index;
+                return *this;
+            }
+            bool operator!=(const Iterator& other) const { return index != other.index; }
+        };
+
+        explicit AuthorList(const Book& owner) : book(owner) {}
+
+        size_t length() const { return book.authorCount(); }
+        bool empty() const { return length() == 0; }
+        string_view operator[](size_t index) const { return bookStrings.text(book.authorHandle(index)); }
+        // Interned handle of an author's name
+        uint32_t handle(size_t index) const { return book.authorHandle(index); }
+        Iterator begin() const { return Iterator(&book, 0); }
+        Iterator end() const { return Iterator(&book, length()); }
+    };
+
+private:
+    // Positions of the fields in a catalog file record
+    enum Field { ID, ISBN, TITLE, EDITION, PUBLICATION, CATEGORY };
+    // Fields kept as text, in block order
+    enum TextField { TEXT_ID, TEXT_ISBN, TEXT_TITLE, TEXT_PUBLICATION, TEXT_FIELDS };
+    // Block positions of the handles
+    static const size_t EDITION_HANDLE = 1;
+    static const size_t CATEGORY_HANDLE = 2;
+    static const size_t AUTHOR_HANDLES = 3;
+
+    uint32_t* block;
+    bool owned;
+
+    size_t authorCount() const {
+        return block == nullptr ? 0 : block[0];
+    }
+
+    uint32_t authorHandle(size_t index) const {
+        return block[AUTHOR_HANDLES + index];
+    }
+
+    uint32_t handle(size_t position) const {
+        return block == nullptr ? InternTable::EMPTY : block[position];
+    }
+
+    const uint32_t* textEnds() const {
+        return block + AUTHOR_HANDLES + block[0];
+    }
+
+    string_view text(TextField index) const {
+        if (block == nullptr) {
+            return string_view();
+        }
+        const uint32_t* ends = textEnds();
+        const char* characters = reinterpret_cast<const char*>(ends + TEXT_FIELDS);
+        uint32_t start = index == 0 ? 0 : ends[index - 1];
+        return string_view(characters + start, ends[index] - start);
+    }
+
+    size_t blockSize() const {
+        return 4 * (AUTHOR_HANDLES + block[0] + TEXT_FIELDS) + textEnds()[TEXT_FIELDS - 1];
+    }
+
+    // Pack fields, given in record order, into a new block taken from arena
+    // or else from the heap
+    static uint32_t* pack(const string_view* fields, size_t count, TextArena* arena) {
+        const Field TEXT_ORDER[TEXT_FIELDS] = {ID, ISBN, TITLE, PUBLICATION};
+        size_t authors = count - FIXED_FIELDS;
+        size_t textSize = 0;
+        for (Field field : TEXT_ORDER) {
+            textSize += fields[field].size();
+        }
+        size_t bytes = 4 * (AUTHOR_HANDLES + authors + TEXT_FIELDS) + textSize;
+        uint32_t* packed = static_cast<uint32_t*>(arena != nullptr ? arena->allocate(bytes) : ::operator new(bytes));
+        packed[0] = static_cast<uint32_t>(authors);
+        packed[EDITION_HANDLE] = bookStrings.intern(fields[EDITION]);
+        packed[CATEGORY_HANDLE] = bookStrings.intern(fields[CATEGORY]);
+        for (size_t i = 0; i < authors; ++i) {
+            packed[AUTHOR_HANDLES + i] = bookStrings.intern(fields[FIXED_FIELDS + i]);
+        }
+        uint32_t* ends = packed + AUTHOR_HANDLES + authors;
+        char* characters = reinterpret_cast<char*>(ends + TEXT_FIELDS);
+        uint32_t end = 0;
+        for (size_t i = 0; i < TEXT_FIELDS; ++i) {
+            const string_view& field = fields[TEXT_ORDER[i]];
+            memcpy(characters + end, field.data(), field.size());
+            end += static_cast<uint32_t>(field.size());
+            ends[i] = end;
+        }
+        return packed;
+    }
+
+    void release() {
+        if (owned) {
+            ::operator delete(block);
+        }
+        block = nullptr;
+        owned = false;
+    }
+
+    // Replace the block with a heap copy of fields
+    void repack(const string_view* fields, size_t count) {
+        uint32_t* packed = pack(fields, count, nullptr);
+        release();
+        block = packed;
+        owned = true;
+    }
+
+    // Every field in record order
+    void collectFields(DynamicArray<string_view>& fields) const {
+        fields.push_back(getId());
+        fields.push_back(getValidIsbn());
+        fields.push_back(getTitle());
+        fields.push_back(getEdition());
+        fields.push_back(getPublication());
+        fields.push_back(getCategory());
+        for (string_view author : getAuthors()) {
+            fields.push_back(author);
+        }
+    }
+
+    void setField(Field index, string_view value) {
+        DynamicArray<string_view> fields;
+        fields.reserve(FIXED_FIELDS + authorCount());
+        collectFields(fields);
+        fields[index] = value;
+        repack(fields.begin(), fields.length());
+    }
+
+public:
+    // Constructors
+    Book() : block(nullptr), owned(false) {}
+    Book(string_view id, string_view isbn, string_view title, const StringArray& authors,
+         string_view edition, string_view publication, string_view category)
+        : block(nullptr), owned(false) {
+        DynamicArray<string_view> fields;
+        fields.reserve(FIXED_FIELDS + authors.length());
+        fields.push_back(id);
+        fields.push_back(isbn);
+        fields.push_back(title);
+        fields.push_back(edition);
+        fields.push_back(publication);
+        fields.push_back(category);
+        for (const string& author : authors) {
+            fields.push_back(author);
+        }
+        repack(fields.begin(), fields.length());
+    }
+
+    // Pack count fields, in block order, into arena (or the heap if null)
+    Book(const string_view* fields, size_t count, TextArena* arena)
+        : block(pack(fields, count, arena)), owned(arena == nullptr) {}
+
+    // Copy other's block into arena
+    Book(const Book& other, TextArena& arena) : block(nullptr), owned(false) {
+        if (other.block != nullptr) {
+            block = static_cast<uint32_t*>(arena.allocate(other.blockSize()));
+            memcpy(block, other.block, other.blockSize());
+        }
+    }
+
+    // Copy constructor; the copy always owns its block
+    Book(const Book& other) : block(nullptr), owned(false) {
+        if (other.block != nullptr) {
+            block = static_cast<uint32_t*>(::operator new(other.blockSize()));
+            memcpy(block, other.block, other.blockSize());
+            owned = true;
+        }
+    }
+
+    // Move constructor
+    Book(Book&& other) noexcept : block(other.block), owned(other.owned) {
+        other.block = nullptr;
+        other.owned = false;
+    }
+
+    // Assignment operator
+    Book& operator=(const Book& other) {
+        if (this != &other) {
+            Book copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    // Move assignment operator
+    Book& operator=(Book&& other) noexcept {
+        if (this != &other) {
+            release();
+            block = other.block;
+            owned = other.owned;
+            other.block = nullptr;
+            other.owned = false;
+        }
+        return *this;
+    }
+
+    // Destructor
+    ~Book() {
+        release();
+    }
+
+    // Getters return views into the book's block or the interned strings,
+    // so reading a book never copies it
+    string_view getId() const { return text(TEXT_ID); }
+    string_view getValidIsbn() const { return text(TEXT_ISBN); }
+    string_view getTitle() const { return text(TEXT_TITLE); }
+    AuthorList getAuthors() const { return AuthorList(*this); }
+    string getAuthorsAsString() const {
+        string result = "";
+        AuthorList authors = getAuthors();
+        for (size_t i = 0; i < authors.length(); ++i) {
+            result += authors[i];
+            if (i < authors.length() - 1) {
+                result += ", ";
+            }
+        }
+        return result;
+    }
+    string_view getEdition() const { return bookStrings.text(getEditionHandle()); }
+    string_view getPublication() const { return text(TEXT_PUBLICATION); }
+    string_view getCategory() const { return bookStrings.text(getCategoryHandle()); }
+
+    // Interned handles, equal for books whose field text is equal
+    uint32_t getEditionHandle() const { return handle(EDITION_HANDLE); }
+    uint32_t getCategoryHandle() const { return handle(CATEGORY_HANDLE); }
+
+    // Bytes held by the book's block
+    size_t textBytes() const { return block == nullptr ? 0 : blockSize(); }
+
+    // Setter methods (excluding ID)
+    void setIsbn(string_view newIsbn) { setField(ISBN, newIsbn); }
+    void setTitle(string_view newTitle) { setField(TITLE, newTitle); }
+    void setAuthors(const StringArray& newAuthors) {
+        DynamicArray<string_view> fields;
+        fields.reserve(FIXED_FIELDS + newAuthors.length());
+        collectFields(fields);
+        fields.resize(FIXED_FIELDS);
+        for (const string& author : newAuthors) {
+            fields.push_back(author);
+        }
+        repack(fields.begin(), fields.length());
+    }
+    void setEdition(string_view newEdition) { setField(EDITION, newEdition); }
+    void setPublication(string_view newPublication) { setField(PUBLICATION, newPublication); }
+    void setCategory(string_view newCategory) { setField(CATEGORY, newCategory); }
+};
+
+// Growable catalog storage. Slots are raw memory until a book is placed in
+// them, so reserving capacity does not construct any Book objects.
+// Deleting a book only marks its slot as removed; compact() later squeezes
+// the removed slots out while keeping the remaining books in order.
+// Every book also gets a sequence number that grows with each addition and
+// survives compaction, so a position in the store can be named stably.
+// The books' text lives in the store's arena: placing a book copies its
+// block there, and the text of replaced or removed books stays behind as
+// waste until compaction repacks the live books into a fresh arena.
+class BookStore {
+private:
+    Book* data;
+    bool* removed;
+    uint64_t* sequences;
+    // Scan columns: each book's publication year and category code, packed
+    // densely so filters on them never touch the books themselves
+    uint16_t* years;
+    uint16_t* categories;
+    TextArena arena;
+    size_t wastedBytes;
+    uint64_t nextSequence;
+    size_t size;
+    size_t liveCount;
+    size_t capacity;
+
+    static const size_t MIN_CAPACITY = 16;
+    static constexpr uint16_t OTHER_CATEGORY = 0xFFFE;
+    static constexpr uint16_t REMOVED_CATEGORY = 0xFFFF;
+
+    void fillColumns(size_t slot) {
+        int year = publicationYear(data[slot].getPublication());
+        int code = categoryCodeOf(data[slot].getCategoryHandle());
+        years[slot] = static_cast<uint16_t>(year < 0xFFFF ? year : 0xFFFF);
+        categories[slot] = code < 0 ? OTHER_CATEGORY : static_cast<uint16_t>(code);
+    }
+
+    // Column filter: a year in [fromYear, toYear] and a category code in
+    // [fromCategory, toCategory], each tested with one unsigned compare so
+    // the scans below have no branches and vectorize
+    struct ColumnFilter {
+        uint16_t from;
+        uint16_t yearSpan;
+        uint16_t lowCategory;
+        uint16_t categorySpan;
+        bool empty;
+
+        ColumnFilter(int fromYear, int toYear, int fromCategory, int toCategory) {
+            fromYear = max(fromYear, 0);
+            toYear = min(toYear, 0xFFFF);
+            empty = fromYear > toYear;
+            from = static_cast<uint16_t>(fromYear);
+            yearSpan = static_cast<uint16_t>(empty ? 0 : toYear - fromYear);
+            lowCategory = fromCategory < 0 ? 0 : static_cast<uint16_t>(fromCategory);
+            categorySpan = fromCategory < 0 ? OTHER_CATEGORY : static_cast<uint16_t>(toCategory - fromCategory);
+        }
+
+        bool matches(uint16_t year, uint16_t category) const {
+            return (static_cast<uint16_t>(year - from) <= yearSpan)
+                 & (static_cast<uint16_t>(category - lowCategory) <= categorySpan);
+        }
+    };
+
+    // Move every book into a larger buffer
+    void reallocate(size_t newCapacity) {
+        Book* newData = static_cast<Book*>(::operator new(newCapacity * sizeof(Book)));
+        bool* newRemoved = new bool[newCapacity];
+        uint64_t* newSequences = new uint64_t[newCapacity];
+        uint16_t* newYears = new uint16_t[newCapacity];
+        uint16_t* newCategories = new uint16_t[newCapacity];
+        for (size_t i = 0; i < size; ++i) {
+            new (&newData[i]) Book(std::move(data[i]));
+            data[i].~Book();
+            newRemoved[i] = removed[i];
+            newSequences[i] = sequences[i];
+            newYears[i] = years[i];
+            newCategories[i] = categories[i];
+        }
+        ::operator delete(data);
+        delete[] removed;
+        delete[] sequences;
+        delete[] years;
+        delete[] categories;
+        data = newData;
+        removed = newRemoved;
+        sequences = newSequences;
+        years = newYears;
+        categories = newCategories;
+        capacity = newCapacity;
+    }
+
+    // Grow geometrically so appends are amortized O(1)
+    void ensureCapacity(size_t minCapacity) {
+        if (minCapacity <= capacity) {
+            return;
+        }
+        size_t newCapacity = capacity < MIN_CAPACITY ? MIN_CAPACITY : capacity;
+        while (newCapacity < minCapacity) {
+            newCapacity *= 2;
+        }
+        reallocate(newCapacity);
+    }
+
+public:
+    // Constructor
+    BookStore()
+        : data(nullptr), removed(nullptr), sequences(nullptr), years(nullptr), categories(nullptr), wastedBytes(0),
+          nextSequence(0), size(0), liveCount(0), capacity(0) {}
+
+    // The store owns every book in the catalog, so it is never copied
+    BookStore(const BookStore&) = delete;
+    BookStore& operator=(const BookStore&) = delete;
+
+    // Destructor
+    ~BookStore() {
+        clear();
+        ::operator delete(data);
+        delete[] removed;
+        delete[] sequences;
+        delete[] years;
+        delete[] categories;
+    }
+
+    // Reserve space ahead of a known number of books
+    void reserve(size_t newCapacity) {
+        if (newCapacity > capacity) {
+            reallocate(newCapacity);
+        }
+    }
+
+    // Add a copy of a book at the end
+    void push_back(const Book& book) {
+        ensureCapacity(size + 1);
+        new (&data[size]) Book(book, arena);
+        removed[size] = false;
+        fillColumns(size);
+        sequences[size++] = nextSequence++;
+        ++liveCount;
+    }
+
+    // Pack count fields, in block order, straight into a new book at the end
+    Book& emplace_back(const string_view* fields, size_t count) {
+        ensureCapacity(size + 1);
+        new (&data[size]) Book(fields, count, &arena);
+        removed[size] = false;
+        fillColumns(size);
+        sequences[size] = nextSequence++;
+        ++liveCount;
+        return data[size++];
+    }
+
+    // Put a new version of a book in its slot. Books are changed only this
+    // way, so the scan columns stay in step.
+    void replace(size_t slot, const Book& book) {
+        wastedBytes += data[slot].textBytes();
+        data[slot] = Book(book, arena);
+        fillColumns(slot);
+    }
+
+    // Mark a slot as removed and drop the book in O(1)
+    void remove(size_t slot) {
+        if (!removed[slot]) {
+            wastedBytes += data[slot].textBytes();
+            data[slot] = Book();
+            removed[slot] = true;
+            categories[slot] = REMOVED_CATEGORY;
+            --liveCount;
+        }
+    }
+
+    // Check if a slot still holds a book
+    bool isLive(size_t slot) const {
+        return !removed[slot];
+    }
+
+    // Number of removed slots waiting for compaction
+    size_t removedCount() const {
+        return size - liveCount;
+    }
+
+    // Slide live books over removed slots, preserving their order.
+    // onMove(from, to) is called after each book moves so indexes can follow.
+    template <typename MoveCallback>
+    void compact(MoveCallback onMove) {
+        size_t next = 0;
+        for (size_t i = 0; i < size; ++i) {
+            if (removed[i]) {
+                continue;
+            }
+            if (i != next) {
+                data[next] = std::move(data[i]);
+                removed[next] = false;
+                sequences[next] = sequences[i];
+                years[next] = years[i];
+                categories[next] = categories[i];
+                onMove(static_cast<int>(i), static_cast<int>(next));
+            }
+            ++next;
+        }
+        for (size_t i = next; i < size; ++i) {
+            data[i].~Book();
+        }
+        size = next;
+        // Once most of the arena is waste, move the live text to a new one
+        if (wastedBytes > arena.bytesUsed() / 2) {
+            TextArena packed;
+            for (size_t i = 0; i < size; ++i) {
+                data[i] = Book(data[i], packed);
+            }
+            arena = std::move(packed);
+            wastedBytes = 0;
+        }
+    }
+
+    // Remove every book but keep the slots. Books in the store own nothing
+    // outside the arena, so dropping the arena's slabs frees them all.
+    void clear() {
+        arena.release();
+        wastedBytes = 0;
+        size = 0;
+        liveCount = 0;
+    }
+
+    // Const access element
+    const Book& operator[](size_t index) const {
+        return data[index];
+    }
+
+    // Sequence number of the book in a slot
+    uint64_t sequence(size_t slot) const {
+        return sequences[slot];
+    }
+
+    // Number of live books published in [fromYear, toYear] and, unless
+    // fromCategory is -1, with a category code in [fromCategory, toCategory].
+    // Only the year and category columns are read, four bytes a slot.
+    size_t countMatching(int fromYear, int toYear, int fromCategory, int toCategory) const {
+        ColumnFilter filter(fromYear, toYear, fromCategory, toCategory);
+        size_t count = 0;
+        if (filter.empty) {
+            return 0;
+        }
+        // Fixed-length blocks let the compiler vectorize the inner loop even
+        // at -O2; the few slots past the last whole block are done one by one
+        const size_t BLOCK = 64;
+        size_t whole = size - size % BLOCK;
+        for (size_t start = 0; start < whole; start += BLOCK) {
+            uint16_t blockCount = 0;
+            for (size_t i = 0; i < BLOCK; ++i) {
+                blockCount += filter.matches(years[start + i], categories[start + i]);
+            }
+            count += blockCount;
+        }
+        for (size_t i = whole; i < size; ++i) {
+            count += filter.matches(years[i], categories[i]);
+        }
+        return count;
+    }
+
+    // The slots countMatching() counts, in slot order
+    void collectMatching(int fromYear, int toYear, int fromCategory, int toCategory, DynamicArray<int>& slots) const {
+        ColumnFilter filter(fromYear, toYear, fromCategory, toCategory);
+        slots.clear();
+        if (filter.empty) {
+            return;
+        }
+        // Write every slot and advance past the ones that match, so the
+        // scan does not branch on each book
+        int found[256];
+        for (size_t start = 0; start < size; start += 256) {
+            size_t end = min(size, start + 256);
+            size_t count = 0;
+            for (size_t i = start; i < end; ++i) {
+                found[count] = static_cast<int>(i);
+                count += filter.matches(years[i], categories[i]);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                slots.push_back(found[i]);
+            }
+        }
+    }
+
+    // Get number of books
+    size_t length() const {
+        return liveCount;
+    }
+
+    // Get number of used slots, including removed ones
+    size_t slotCount() const {
+        return size;
+    }
+
+    // Get allocated slots
+    size_t reserved() const {
+        return capacity;
+    }
+
+    // Bytes of book text in the arena, including text waiting for compaction
+    size_t textBytes() const {
+        return arena.bytesUsed();
+    }
+
+    // Check if empty
+    bool empty() const {
+        return liveCount == 0;
+    }
+};
+
+// Key traits for indexing books by ID
+struct BookIdKey {
+    static string_view keyOf(const Book& book) { return book.getId(); }
+    static size_t hash(string_view key) { return caseInsensitiveHash(key); }
+    static bool matches(const Book& book, string_view key) {
+        return caseInsensitiveCompare(book.getId(), key);
+    }
+};
+
+// Key traits for indexing books by canonical ISBN
+struct BookIsbnKey {
+    static string keyOf(const Book& book) { return canonicalIsbn(book.getValidIsbn()); }
+    static size_t hash(string_view key) { return caseInsensitiveHash(key); }
+    static bool matches(const Book& book, string_view key) {
+        return canonicalIsbn(book.getValidIsbn()) == key;
+    }
+};
+
+// Sort orders for OrderedIndex. compare() orders two books and keyOf()
+// gives the text they are sorted on. compareKey() places a book against
+// such a key; with prefixOnly, as used for the ends of a range typed by the
+// user, a key matches every key it begins ("C" takes in "Carrie").
+struct BookAddedOrder {
+    static int compare(const Book&, const Book&) { return 0; }
+    static string_view keyOf(const Book&) { return string_view(); }
+    static int compareKey(const Book&, string_view, bool = false) { return 0; }
+    static bool validBound(string_view) { return true; }
+};
+
+struct BookTitleOrder {
+    static int compare(const Book& a, const Book& b) {
+        return caseInsensitiveOrder(a.getTitle(), b.getTitle());
+    }
+    static string_view keyOf(const Book& book) { return book.getTitle(); }
+    static int compareKey(const Book& book, string_view key, bool prefixOnly = false) {
+        return caseInsensitiveOrder(book.getTitle(), key, prefixOnly);
+    }
+    static bool validBound(string_view) { return true; }
+};
+
+struct BookIdOrder {
+    static int compare(const Book& a, const Book& b) {
+        return caseInsensitiveOrder(a.getId(), b.getId());
+    }
+    static string_view keyOf(const Book& book) { return book.getId(); }
+    static int compareKey(const Book& book, string_view key, bool prefixOnly = false) {
+        return caseInsensitiveOrder(book.getId(), key, prefixOnly);
+    }
+    static bool validBound(string_view bound) { return isValidId(bound); }
+};
+
+struct BookYearOrder {
+    static int compare(const Book& a, const Book& b) {
+        int x = publicationYear(a.getPublication());
+        int y = publicationYear(b.getPublication());
+        return x == y ? 0 : x < y ? -1 : 1;
+    }
+    static string_view keyOf(const Book& book) { return book.getPublication(); }
+    static int compareKey(const Book& book, string_view key, bool = false) {
+        int x = publicationYear(book.getPublication());
+        int y = publicationYear(key);
+        return x == y ? 0 : x < y ? -1 : 1;
+    }
+    static bool validBound(string_view bound) {
+        return checkPublicationYear(bound) == YEAR_OK;
+    }
+};
+
+struct BookEditionOrder {
+    static int compare(const Book& a, const Book& b) {
+        if (a.getEditionHandle() == b.getEditionHandle()) {
+            return 0;
+        }
+        return compareEditions(a.getEdition(), b.getEdition());
+    }
+    static string_view keyOf(const Book& book) { return book.getEdition(); }
+    static int compareKey(const Book& book, string_view key, bool prefixOnly = false) {
+        return compareEditions(book.getEdition(), key, prefixOnly);
+    }
+    static bool validBound(string_view) { return true; }
+};
+
+// Open-addressing hash index from a book key to its slot in the store.
+// Entries only hold the hash and the slot; keys are read back from the
+// store, so the index costs 16 bytes per book.
+template <typename KeyTraits>
+class HashIndex {
+private:
+    struct Entry {
+        size_t hash;
+        int slot;
+    };
+
+    static const int EMPTY = -1;
+    static const size_t MIN_CAPACITY = 16;
+
+    const BookStore& store;
+    Entry* table;
+    size_t capacity;
+    size_t count;
+
+    size_t mask() const {
+        return capacity - 1;
+    }
+
+    // Position of the entry for key, or of the empty cell ending its probe run
+    size_t probe(string_view key, size_t hash) const {
+        size_t pos = hash & mask();
+        while (table[pos].slot != EMPTY) {
+            if (table[pos].hash == hash && KeyTraits::matches(store[static_cast<size_t>(table[pos].slot)], key)) {
+                break;
+            }
+            pos = (pos + 1) & mask();
+        }
+        return pos;
+    }
+
+    // Position of the entry pointing at slot, found through that slot's key
+    size_t probeSlot(string_view key, int slot) const {
+        size_t pos = KeyTraits::hash(key) & mask();
+        while (table[pos].slot != EMPTY && table[pos].slot != slot) {
+            pos = (pos + 1) & mask();
+        }
+        return pos;
+    }
+
+    void rehash(size_t newCapacity) {
+        Entry* oldTable = table;
+        size_t oldCapacity = capacity;
+
+        table = new Entry[newCapacity];
+        capacity = newCapacity;
+        for (size_t i = 0; i < capacity; ++i) {
+            table[i].slot = EMPTY;
+        }
+        for (size_t i = 0; i < oldCapacity; ++i) {
+            if (oldTable[i].slot != EMPTY) {
+                size_t pos = oldTable[i].hash & mask();
+                while (table[pos].slot != EMPTY) {
+                    pos = (pos + 1) & mask();
+                }
+                table[pos] = oldTable[i];
+            }
+        }
+        delete[] oldTable;
+    }
+
+    // Keep the load factor at or below 3/4
+    void ensureCapacity(size_t entries) {
+        size_t newCapacity = capacity < MIN_CAPACITY ? MIN_CAPACITY : capacity;
+        while (entries * 4 > newCapacity * 3) {
+            newCapacity *= 2;
+        }
+        if (newCapacity != capacity) {
+            rehash(newCapacity);
+        }
+    }
+
+    // Remove the entry at pos by shifting later members of its run back,
+    // so lookups never have to skip over deleted markers
+    void removeAt(size_t pos) {
+        size_t hole = pos;
+        size_t next = (hole + 1) & mask();
+        while (table[next].slot != EMPTY) {
+            size_t home = table[next].hash & mask();
+            if (((next - home) & mask()) >= ((next - hole) & mask())) {
+                table[hole] = table[next];
+                hole = next;
+            }
+            next = (next + 1) & mask();
+        }
+        table[hole].slot = EMPTY;
+        --count;
+    }
+
+public:
+    // Constructor
+    explicit HashIndex(const BookStore& books) : store(books), table(nullptr), capacity(0), count(0) {}
+
+    HashIndex(const HashIndex&) = delete;
+    HashIndex& operator=(const HashIndex&) = delete;
+
+    // Destructor
+    ~HashIndex() {
+        delete[] table;
+    }
+
+    // Size the table ahead of a known number of books
+    void reserve(size_t entries) {
+        ensureCapacity(entries);
+    }
+
+    // Slot of the book with this key, or -1 if there is none
+    int find(string_view key) const {
+        if (count == 0) {
+            return -1;
+        }
+        size_t pos = probe(key, KeyTraits::hash(key));
+        return table[pos].slot;
+    }
+
+    // Slot of the indexed book sharing the key of the book stored at slot, or -1
+    int findSlotKey(int slot) const {
+        if (count == 0) {
+            return -1;
+        }
+        const auto& key = KeyTraits::keyOf(store[static_cast<size_t>(slot)]);
+        return table[probe(key, KeyTraits::hash(key))].slot;
+    }
+
+    // Index the book stored at slot; fails if its key is already present
+    bool insert(int slot) {
+        ensureCapacity(count + 1);
+        const auto& key = KeyTraits::keyOf(store[static_cast<size_t>(slot)]);
+        size_t hash = KeyTraits::hash(key);
+        size_t pos = probe(key, hash);
+        if (table[pos].slot != EMPTY) {
+            return false;
+        }
+        table[pos].hash = hash;
+        table[pos].slot = slot;
+        ++count;
+        return true;
+    }
+
+    // Drop the entry for the book stored at slot
+    void erase(int slot) {
+        if (count == 0) {
+            return;
+        }
+        size_t pos = probeSlot(KeyTraits::keyOf(store[static_cast<size_t>(slot)]), slot);
+        if (table[pos].slot == slot) {
+            removeAt(pos);
+        }
+    }
+
+    // Point the entry for a book at its new slot after the book was moved there
+    void relocate(int oldSlot, int newSlot) {
+        if (count == 0) {
+            return;
+        }
+        size_t pos = probeSlot(KeyTraits::keyOf(store[static_cast<size_t>(newSlot)]), oldSlot);
+        if (table[pos].slot == oldSlot) {
+            table[pos].slot = newSlot;
+        }
+    }
+
+    // Remove every entry but keep the table
+    void clear() {
+        for (size_t i = 0; i < capacity; ++i) {
+            table[i].slot = EMPTY;
+        }
+        count = 0;
+    }
+
+    // Get number of indexed books
+    size_t length() const {
+        return count;
+    }
+};
+
+// Read-only view of a whole file. On POSIX systems the file is memory-mapped;
+// elsewhere it is read into memory in one go.
+class MappedFile {
+private:
+    const char* bytes;
+    size_t size;
+    bool mapped;
+    string buffer;
+
+public:
+    // Constructor
+    MappedFile() : bytes(nullptr), size(0), mapped(false) {}
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Destructor
+    ~MappedFile() {
+#ifdef LMS_POSIX
+        if (mapped) {
+            munmap(const_cast<char*>(bytes), size);
+        }
+#endif
+    }
+
+    // Map the file; returns false if it does not exist or cannot be read
+    bool open(const string& path) {
+#ifdef LMS_POSIX
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            return false;
+        }
+        size = static_cast<size_t>(info.st_size);
+        if (size > 0) {
+            int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+            // The whole file is about to be read, so fault it in up front
+            flags |= MAP_POPULATE;
+#endif
+            void* address = mmap(nullptr, size, PROT_READ, flags, fd, 0);
+            if (address != MAP_FAILED) {
+                bytes = static_cast<const char*>(address);
+                mapped = true;
+            }
+        }
+        ::close(fd);
+        if (size > 0 && !mapped) {
+            return false;
+        }
+        return true;
+#else
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == nullptr) {
+            return false;
+        }
+        char chunk[1 << 16];
+        size_t count;
+        while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            buffer.append(chunk, count);
+        }
+        fclose(file);
+        bytes = buffer.data();
+        size = buffer.size();
+        return true;
+#endif
+    }
+
+    const char* data() const {
+        return bytes;
+    }
+
+    size_t length() const {
+        return size;
+    }
+};
+
+// Little-endian encoding helpers for the on-disk formats
+void putU32(char* out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+void putU64(char* out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+uint32_t getU32(const char* in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+    }
+    return value;
+}
+
+uint64_t getU64(const char* in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+    }
+    return value;
+}
+
+// 64-bit checksum that can be fed in pieces. It mixes eight bytes per step
+// (FNV-style multiply plus a shift) so verifying a large file is cheap.
+class Checksum {
+private:
+    uint64_t value;
+    uint64_t total;
+    char tail[8];
+    size_t tailSize;
+
+    void mix(uint64_t word) {
+        value ^= word;
+        value *= 1099511628211ULL;
+        value ^= value >> 32;
+    }
+
+public:
+    Checksum() : value(14695981039346656037ULL), total(0), tailSize(0) {}
+
+    void update(const char* bytes, size_t count) {
+        total += count;
+        while (tailSize > 0 && tailSize < 8 && count > 0) {
+            tail[tailSize++] = *bytes++;
+            --count;
+        }
+        if (tailSize == 8) {
+            mix(getU64(tail));
+            tailSize = 0;
+        }
+        for (; count >= 8; count -= 8, bytes += 8) {
+            mix(getU64(bytes));
+        }
+        for (; count > 0; --count) {
+            tail[tailSize++] = *bytes++;
+        }
+    }
+
+    uint64_t result() const {
+        Checksum last = *this;
+        char padded[8] = {};
+        memcpy(padded, tail, tailSize);
+        last.mix(getU64(padded));
+        last.mix(total);
+        return last.value;
+    }
+};
+
+// Append little-endian fields and book records to an in-memory buffer
+void appendU32(string& out, uint32_t value) {
+    char bytes[4];
+    putU32(bytes, value);
+    out.append(bytes, 4);
+}
+
+void appendString(string& out, string_view value) {
+    appendU32(out, static_cast<uint32_t>(value.length()));
+    out.append(value);
+}
+
+// Append a book record, prefixed by its length so readers can skip it
+void appendBook(string& out, const Book& book) {
+    Book::AuthorList authors = book.getAuthors();
+    size_t recordSize = 4 * 7 + book.getId().length() + book.getValidIsbn().length() +
+                        book.getTitle().length() + book.getEdition().length() +
+                        book.getPublication().length() + book.getCategory().length();
+    for (string_view author : authors) {
+        recordSize += 4 + author.length();
+    }
+    appendU32(out, static_cast<uint32_t>(recordSize));
+    appendString(out, book.getId());
+    appendString(out, book.getValidIsbn());
+    appendString(out, book.getTitle());
+    appendString(out, book.getEdition());
+    appendString(out, book.getPublication());
+    appendString(out, book.getCategory());
+    appendU32(out, static_cast<uint32_t>(authors.length()));
+    for (string_view author : authors) {
+        appendString(out, author);
+    }
+}
+
+// Buffered binary writer over a stdio file that checksums what it writes
+class BinaryWriter {
+private:
+    static const size_t BUFFER_SIZE = 1 << 20;
+
+    FILE* file;
+    string buffer;
+    Checksum checksum;
+    uint64_t written;
+    bool failed;
+
+public:
+    explicit BinaryWriter(FILE* target) : file(target), written(0), failed(false) {
+        buffer.reserve(BUFFER_SIZE);
+    }
+
+    void putBook(const Book& book) {
+        appendBook(buffer, book);
+        if (buffer.size() >= BUFFER_SIZE) {
+            flush();
+        }
+    }
+
+    void flush() {
+        if (buffer.empty()) {
+            return;
+        }
+        checksum.update(buffer.data(), buffer.size());
+        if (fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+            failed = true;
+        }
+        written += buffer.size();
+        buffer.clear();
+    }
+
+    uint64_t bytesWritten() const {
+        return written;
+    }
+
+    uint64_t checksumValue() const {
+        return checksum.result();
+    }
+
+    bool ok() const {
+        return !failed;
+    }
+};
+
+// Bounds-checked reader over a byte range
+class BinaryReader {
+private:
+    const char* pos;
+    const char* end;
+    bool failed;
+    DynamicArray<string_view> fields;
+
+    // View of a length-prefixed string in place
+    bool getView(string_view& out) {
+        uint32_t length = getU32();
+        if (failed || static_cast<size_t>(end - pos) < length) {
+            failed = true;
+            return false;
+        }
+        out = string_view(pos, length);
+        pos += length;
+        return true;
+    }
+
+public:
+    BinaryReader(const char* begin, const char* limit) : pos(begin), end(limit), failed(false) {}
+
+    uint32_t getU32() {
+        if (end - pos < 4) {
+            failed = true;
+            return 0;
+        }
+        uint32_t value = ::getU32(pos);
+        pos += 4;
+        return value;
+    }
+
+    bool getString(string& out) {
+        uint32_t length = getU32();
+        if (failed || static_cast<size_t>(end - pos) < length) {
+            failed = true;
+            return false;
+        }
+        out.assign(pos, length);
+        pos += length;
+        return true;
+    }
+
+    // Read a book record written by appendBook into fields. The record
+    // keeps the fields in book block order, so they are views into the
+    // input, ready to be packed.
+    bool readBook() {
+        uint32_t recordSize = getU32();
+        if (failed || static_cast<size_t>(end - pos) < recordSize) {
+            failed = true;
+            return false;
+        }
+        const char* recordEnd = pos + recordSize;
+        fields.resize(Book::FIXED_FIELDS);
+        for (size_t i = 0; i < Book::FIXED_FIELDS; ++i) {
+            getView(fields[i]);
+        }
+        uint32_t authorCount = getU32();
+        if (failed || authorCount > recordSize / 4) {
+            failed = true;
+            return false;
+        }
+        fields.resize(Book::FIXED_FIELDS + authorCount);
+        for (uint32_t i = 0; i < authorCount; ++i) {
+            getView(fields[Book::FIXED_FIELDS + i]);
+        }
+        if (failed || pos != recordEnd) {
+            failed = true;
+            return false;
+        }
+        return true;
+    }
+
+    // Read a book record and append it to the store
+    bool getBook(BookStore& books) {
+        if (!readBook()) {
+            return false;
+        }
+        books.emplace_back(fields.begin(), fields.length());
+        return true;
+    }
+
+    // Read a book record into a single book
+    bool getBook(Book& out) {
+        if (!readBook()) {
+            return false;
+        }
+        out = Book(fields.begin(), fields.length(), nullptr);
+        return true;
+    }
+
+    uint8_t getU8() {
+        if (pos == end) {
+            failed = true;
+            return 0;
+        }
+        return static_cast<uint8_t>(*pos++);
+    }
+
+    bool atEnd() const {
+        return pos == end;
+    }
+
+    bool ok() const {
+        return !failed;
+    }
+};
+
+// Versioned binary catalog file:
+//   header  magic "KLMSCAT1", u32 version, u32 reserved, u64 book count,
+//           u64 payload size, u64 checksum of the payload
+//   payload one length-prefixed record per book
+// All integers are little-endian and nothing holds a pointer, so the file
+// can be mapped and read in place.
+class CatalogFile {
+public:
+    enum LoadResult { LOADED, MISSING, CORRUPT };
+
+    static const uint32_t VERSION = 1;
+    static const size_t HEADER_SIZE = 40;
+
+    // Append every book in the file to the store
+    static LoadResult load(const string& path, BookStore& books, string& error) {
+        MappedFile file;
+        if (!file.open(path)) {
+            return MISSING;
+        }
+        const char* bytes = file.data();
+        if (file.length() < HEADER_SIZE || string(bytes, 8) != MAGIC) {
+            error = "not a catalog file";
+            return CORRUPT;
+        }
+        if (getU32(bytes + 8) != VERSION) {
+            error = "unsupported catalog version " + to_string(getU32(bytes + 8));
+            return CORRUPT;
+        }
+        uint64_t bookCount = getU64(bytes + 16);
+        uint64_t payloadSize = getU64(bytes + 24);
+        if (payloadSize != file.length() - HEADER_SIZE) {
+            error = "catalog file is truncated";
+            return CORRUPT;
+        }
+        Checksum checksum;
+        checksum.update(bytes + HEADER_SIZE, payloadSize);
+        if (checksum.result() != getU64(bytes + 32)) {
+            error = "catalog checksum mismatch";
+            return CORRUPT;
+        }
+
+        books.reserve(books.slotCount() + bookCount);
+        BinaryReader reader(bytes + HEADER_SIZE, bytes + file.length());
+        for (uint64_t i = 0; i < bookCount; ++i) {
+            if (!reader.getBook(books)) {
+                error = "malformed book record " + to_string(i + 1);
+                return CORRUPT;
+            }
+        }
+        if (!reader.atEnd()) {
+            error = "unexpected data after the last book";
+            return CORRUPT;
+        }
+        return LOADED;
+    }
+
+    // Write every live book to path, replacing the old file only once the
+    // new one is complete
+    static bool save(const string& path, const BookStore& books, string& error) {
+        string tempPath = path + ".tmp";
+        FILE* file = fopen(tempPath.c_str(), "wb");
+        if (file == nullptr) {
+            error = "cannot open " + tempPath;
+            return false;
+        }
+
+        char header[HEADER_SIZE] = {};
+        fwrite(header, 1, HEADER_SIZE, file);
+        BinaryWriter writer(file);
+        for (size_t i = 0; i < books.slotCount(); ++i) {
+            if (books.isLive(i)) {
+                writer.putBook(books[i]);
+            }
+        }
+        writer.flush();
+
+        memcpy(header, MAGIC, 8);
+        putU32(header + 8, VERSION);
+        putU32(header + 12, 0);
+        putU64(header + 16, books.length());
+        putU64(header + 24, writer.bytesWritten());
+        putU64(header + 32, writer.checksumValue());
+        bool ok = writer.ok() && fseek(file, 0, SEEK_SET) == 0 &&
+                  fwrite(header, 1, HEADER_SIZE, file) == HEADER_SIZE && fflush(file) == 0;
+#ifdef LMS_POSIX
+        ok = ok && fsync(fileno(file)) == 0;
+#endif
+        ok = fclose(file) == 0 && ok;
+        if (!ok) {
+            error = "failed writing " + tempPath;
+            remove(tempPath.c_str());
+            return false;
+        }
+#ifdef _WIN32
+        remove(path.c_str());
+#endif
+        if (rename(tempPath.c_str(), path.c_str()) != 0) {
+            error = "cannot replace " + path;
+            return false;
+        }
+#ifdef LMS_POSIX
+        // The new name only survives a crash once the directory is synced,
+        // and the journal is emptied as soon as this returns
+        if (!syncDirectoryOf(path)) {
+            error = "cannot sync the directory of " + path;
+            return false;
+        }
+#endif
+        return true;
+    }
+
+private:
+    static constexpr const char* MAGIC = "KLMSCAT1";
+
+#ifdef LMS_POSIX
+    static bool syncDirectoryOf(const string& path) {
+        size_t slash = path.rfind('/');
+        string directory = slash == string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+        int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        bool synced = fsync(fd) == 0;
+        close(fd);
+        return synced;
+    }
+#endif
+};
+
+// Append-only journal of catalog changes. Each record holds the full new
+// state of one book (or the ID of a deleted one), so replaying the journal
+// over a snapshot that already contains some of its changes ends in the
+// same catalog. Records are buffered by log*() and made durable together by
+// commit(), letting callers group several changes into one sync.
+//   file    magic "KLMSJRN1", u32 version, u32 reserved, then records
+//   record  u32 payload size, u64 payload checksum, payload
+//   payload u8 operation, then a book record or an ID string
+class Journal {
+public:
+    enum Operation { ADD_BOOK = 1, EDIT_BOOK = 2, DELETE_BOOK = 3 };
+
+    static const uint32_t VERSION = 1;
+    static const size_t HEADER_SIZE = 16;
+
+private:
+    static const size_t RECORD_HEADER_SIZE = 12;
+
+    string path;
+    string pending;
+    uint64_t records;
+    // File length up to the last committed record, and whether a failed
+    // write may have left a partial group past it
+    uint64_t committedEnd;
+    bool torn;
+    bool replayOnly;  // another owner writes the file; records are not kept
+#ifdef LMS_POSIX
+    int fd;
+#else
+    FILE* file;
+#endif
+
+    static string fileHeader() {
+        char header[HEADER_SIZE] = {};
+        memcpy(header, MAGIC, 8);
+        putU32(header + 8, VERSION);
+        return string(header, HEADER_SIZE);
+    }
+
+    void beginRecord(Operation operation, size_t& start) {
+        start = pending.size();
+        pending.append(RECORD_HEADER_SIZE, '\0');
+        pending.push_back(static_cast<char>(operation));
+    }
+
+    void endRecord(size_t start) {
+        size_t payload = start + RECORD_HEADER_SIZE;
+        Checksum checksum;
+        checksum.update(pending.data() + payload, pending.size() - payload);
+        putU32(&pending[start], static_cast<uint32_t>(pending.size() - payload));
+        putU64(&pending[start + 4], checksum.result());
+    }
+
+    bool writeAll(const string& bytes) {
+#ifdef LMS_POSIX
+        size_t done = 0;
+        while (done < bytes.size()) {
+            ssize_t count = ::write(fd, bytes.data() + done, bytes.size() - done);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            done += static_cast<size_t>(count);
+        }
+        return true;
+#else
+        return fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+#endif
+    }
+
+    bool sync() {
+#if defined(__linux__)
+        return fdatasync(fd) == 0;
+#elif defined(LMS_POSIX)
+        return fsync(fd) == 0;
+#else
+        return fflush(file) == 0;
+#endif
+    }
+
+    // Open the journal for appending, starting a fresh file when truncate is set
+    bool openForAppend(bool truncate) {
+        bool fresh = truncate;
+#ifdef LMS_POSIX
+        fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | (truncate ? O_TRUNC : 0), 0644);
+        if (fd < 0) {
+            return false;
+        }
+        off_t end = lseek(fd, 0, SEEK_END);
+        fresh = fresh || end == 0;
+#else
+        file = fopen(path.c_str(), truncate ? "wb" : "ab");
+        if (file == nullptr) {
+            return false;
+        }
+        fseek(file, 0, SEEK_END);
+        long end = ftell(file);
+        fresh = fresh || end == 0;
+#endif
+        committedEnd = fresh ? HEADER_SIZE : static_cast<uint64_t>(end);
+        torn = false;
+        return !fresh || (writeAll(fileHeader()) && sync());
+    }
+
+    void closeFile() {
+#ifdef LMS_POSIX
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+#else
+        if (file != nullptr) {
+            fclose(file);
+            file = nullptr;
+        }
+#endif
+    }
+
+    // Replace the journal with its first validLength bytes after a torn write
+    bool truncateTo(const char* bytes, size_t validLength) {
+        string tempPath = path + ".tmp";
+        FILE* out = fopen(tempPath.c_str(), "wb");
+        if (out == nullptr) {
+            return false;
+        }
+        bool ok = fwrite(bytes, 1, validLength, out) == validLength;
+        ok = fclose(out) == 0 && ok;
+#ifdef _WIN32
+        remove(path.c_str());
+#endif
+        return ok && rename(tempPath.c_str(), path.c_str()) == 0;
+    }
+
+    // Cut the file back to its committed records after a failed write, so
+    // a partial group never sits ahead of records committed later
+    bool cutBack() {
+#ifdef LMS_POSIX
+        return ftruncate(fd, static_cast<off_t>(committedEnd)) == 0;
+#else
+        uint64_t end = committedEnd;
+        closeFile();
+        bool cut;
+        {
+            MappedFile existing;
+            cut = existing.open(path) && existing.length() >= end && truncateTo(existing.data(), end);
+        }
+        bool reopened = openForAppend(false);
+        committedEnd = end;
+        return cut && reopened;
+#endif
+    }
+
+public:
+    // Constructor
+    explicit Journal(const string& journalPath)
+        : path(journalPath), records(0), committedEnd(HEADER_SIZE), torn(false), replayOnly(false) {
+#ifdef LMS_POSIX
+        fd = -1;
+#else
+        file = nullptr;
+#endif
+    }
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Destructor
+    ~Journal() {
+        string error;
+        commit(error);
+        closeFile();
+    }
+
+    // Replay every intact record through apply(operation, id, book), drop a
+    // torn tail left by a crash, and open the journal for new records. With
+    // readOnly the file is left alone and later records are not kept.
+    template <typename ApplyRecord>
+    bool open(ApplyRecord apply, string& error, bool readOnly = false) {
+        replayOnly = readOnly;
+        MappedFile existing;
+        if (existing.open(path) && existing.length() > 0) {
+            const char* bytes = existing.data();
+            size_t length = existing.length();
+            if (length < HEADER_SIZE || string(bytes, 8) != MAGIC || getU32(bytes + 8) != VERSION) {
+                error = "not a journal file";
+                return false;
+            }
+            size_t pos = HEADER_SIZE;
+            while (length - pos >= RECORD_HEADER_SIZE) {
+                uint32_t payloadSize = getU32(bytes + pos);
+                const char* payload = bytes + pos + RECORD_HEADER_SIZE;
+                if (payloadSize > length - pos - RECORD_HEADER_SIZE) {
+                    break;
+                }
+                Checksum checksum;
+                checksum.update(payload, payloadSize);
+                if (checksum.result() != getU64(bytes + pos + 4)) {
+                    break;
+                }
+                BinaryReader reader(payload, payload + payloadSize);
+                Operation operation = static_cast<Operation>(reader.getU8());
+                string id;
+                Book book;
+                bool parsed = operation == DELETE_BOOK ? reader.getString(id) : reader.getBook(book);
+                if (!parsed || !reader.atEnd()) {
+                    break;
+                }
+                if (operation != DELETE_BOOK) {
+                    id = book.getId();
+                }
+                apply(operation, id, book);
+                pos += RECORD_HEADER_SIZE + payloadSize;
+                ++records;
+            }
+            if (replayOnly) {
+                return true;
+            }
+            if (pos != length && !truncateTo(bytes, pos)) {
+                error = "cannot drop the damaged end of " + path;
+                return false;
+            }
+        }
+        if (!replayOnly && !openForAppend(false)) {
+            error = "cannot open " + path + " for writing";
+            return false;
+        }
+        return true;
+    }
+
+    void logAdd(const Book& book) {
+        if (replayOnly) {
+            return;
+        }
+        size_t start;
+        beginRecord(ADD_BOOK, start);
+        appendBook(pending, book);
+        endRecord(start);
+    }
+
+    void logEdit(const Book& book) {
+        if (replayOnly) {
+            return;
+        }
+        size_t start;
+        beginRecord(EDIT_BOOK, start);
+        appendBook(pending, book);
+        endRecord(start);
+    }
+
+    void logDelete(string_view id) {
+        if (replayOnly) {
+            return;
+        }
+        size_t start;
+        beginRecord(DELETE_BOOK, start);
+        appendString(pending, id);
+        endRecord(start);
+    }
+
+    // Write every pending record and sync once for the whole group. If that
+    // fails, whatever part of the group reached the file is cut off again
+    // and the records stay pending for the next commit.
+    bool commit(string& error) {
+        if (pending.empty()) {
+            return true;
+        }
+        if ((torn && !cutBack()) || !writeAll(pending) || !sync()) {
+            torn = !cutBack();
+            error = "failed writing " + path;
+            return false;
+        }
+        torn = false;
+        committedEnd += pending.size();
+        for (size_t pos = 0; pos < pending.size(); pos += RECORD_HEADER_SIZE + getU32(&pending[pos])) {
+            ++records;
+        }
+        pending.clear();
+        return true;
+    }
+
+    // Drop records that have not been committed
+    void discard() {
+        pending.clear();
+    }
+
+    // Empty the journal once its changes are safely in a snapshot
+    bool reset(string& error) {
+        closeFile();
+        if (!openForAppend(true)) {
+            error = "cannot reset " + path;
+            return false;
+        }
+        records = 0;
+        return true;
+    }
+
+    // Get number of committed records
+    uint64_t length() const {
+        return records;
+    }
+
+private:
+    static constexpr const char* MAGIC = "KLMSJRN1";
+};
+
+// Check for line breaks, tabs and other control characters, which the
+// prompts cannot produce because they read whole lines
+bool hasControlCharacter(string_view value) {
+    for (char c : value) {
+        if (iscntrl(static_cast<unsigned char>(c))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Check that a new or changed book's edition, category and authors fit in
+// bookStrings, before the book is built. Returns an error message, or "".
+string checkInternedFields(string_view edition, string_view category, const StringArray& authors) {
+    DynamicArray<string_view> values;
+    values.reserve(2 + authors.length());
+    values.push_back(edition);
+    values.push_back(category);
+    for (const string& author : authors) {
+        values.push_back(author);
+    }
+    if (!bookStrings.hasRoomFor(values.begin(), values.length())) {
+        return "too many distinct editions, categories and author names; restart to reclaim unused ones";
+    }
+    return "";
+}
+
+// Check a book against the same rules as the prompts and put its category
+// in canonical form. Returns an error message, or "" if the book is valid.
+string validateBook(Book& book) {
+    // Checked first so no message below repeats a line break
+    const pair<const char*, string_view> fields[] = {
+        {"ID", book.getId()}, {"ISBN", book.getValidIsbn()}, {"title", book.getTitle()},
+        {"edition", book.getEdition()}, {"publication year", book.getPublication()}, {"category", book.getCategory()}};
+    for (const auto& field : fields) {
+        if (hasControlCharacter(field.second)) {
+            return string(field.first) + " contains a line break or control character";
+        }
+    }
+    for (string_view author : book.getAuthors()) {
+        if (hasControlCharacter(author)) {
+            return "an author name contains a line break or control character";
+        }
+    }
+    if (!isValidId(book.getId())) {
+        return "invalid ID '" + string(book.getId()) + "' (must be alphanumeric)";
+    }
+    IsbnCheck isbnCheck = checkIsbn(book.getValidIsbn());
+    if (book.getValidIsbn().empty() || isbnCheck == ISBN_BAD_CHARACTERS) {
+        return "invalid ISBN '" + string(book.getValidIsbn()) + "' (only digits and 'x' allowed)";
+    }
+    if (isbnCheck == ISBN_BAD_LENGTH) {
+        return "invalid ISBN '" + string(book.getValidIsbn()) + "' (must be 10 or 13 characters)";
+    }
+    if (book.getTitle().empty()) {
+        return "title is empty";
+    }
+    if (book.getAuthors().empty()) {
+        return "no authors given";
+    }
+    for (string_view author : book.getAuthors()) {
+        if (author.empty()) {
+            return "author list has an empty name";
+        }
+    }
+    if (book.getEdition().empty()) {
+        return "edition is empty";
+    }
+    YearCheck yearCheck = checkPublicationYear(book.getPublication());
+    if (yearCheck == YEAR_NOT_FOUR_DIGITS) {
+        return "invalid publication year '" + string(book.getPublication()) + "' (must be 4 digits)";
+    }
+    if (yearCheck == YEAR_OUT_OF_RANGE) {
+        return "publication year " + string(book.getPublication()) + " is not between 1000 and 2100";
+    }
+    string category;
+    if (!normalizeCategory(book.getCategory(), category)) {
+        return "unknown category '" + string(book.getCategory()) + "'";
+    }
+    if (category != book.getCategory()) {
+        book.setCategory(category);
+    }
+    return "";
+}
+
+// A row rejected during bulk import
+struct ImportError {
+    size_t line;
+    string message;
+
+    bool operator<(const ImportError& other) const {
+        return line < other.line;
+    }
+};
+
+// Bulk loader for CSV and TSV files with one book per row:
+//   id, isbn, title, authors (separated by ';'), edition, publication, category
+// Quoted fields may contain delimiters, quotes ("") and line breaks, and a
+// header row is skipped. The file is cut into chunks at row boundaries and
+// each chunk is parsed and validated on its own thread with the same rules
+// as the prompts. ID uniqueness is left to the caller, which inserts the
+// valid books chunk by chunk in file order.
+class BookImporter {
+public:
+    struct Chunk {
+        const char* begin;
+        const char* end;
+        size_t firstLine;
+        BookStore books;
+        DynamicArray<size_t> lines;
+        DynamicArray<ImportError> errors;
+    };
+
+    static const int FIELD_COUNT = 7;
+
+private:
+    static const size_t MIN_CHUNK_BYTES = 1 << 20;
+
+    MappedFile file;
+    char delimiter;
+    Chunk* chunks;
+    size_t chunkCount;
+
+    // Split the file into about count chunks that end on row boundaries
+    void splitChunks(size_t count) {
+        const char* begin = file.data();
+        const char* end = begin + file.length();
+        size_t target = file.length() / count + 1;
+
+        chunks = new Chunk[count];
+        chunkCount = 0;
+        const char* chunkStart = begin;
+        size_t line = 1;
+        size_t chunkLine = 1;
+        bool inQuotes = false;
+        for (const char* pos = begin; pos < end; ++pos) {
+            if (*pos == '"') {
+                inQuotes = !inQuotes;
+            } else if (*pos == '\n') {
+                ++line;
+                if (!inQuotes && static_cast<size_t>(pos + 1 - chunkStart) >= target &&
+                    chunkCount + 1 < count) {
+                    chunks[chunkCount].begin = chunkStart;
+                    chunks[chunkCount].end = pos + 1;
+                    chunks[chunkCount].firstLine = chunkLine;
+                    ++chunkCount;
+                    chunkStart = pos + 1;
+                    chunkLine = line;
+                }
+            }
+        }
+        if (chunkStart < end || chunkCount == 0) {
+            chunks[chunkCount].begin = chunkStart;
+            chunks[chunkCount].end = end;
+            chunks[chunkCount].firstLine = chunkLine;
+            ++chunkCount;
+        }
+    }
+
+    static void trimInPlace(string& field) {
+        size_t end = field.find_last_not_of(" \t");
+        if (end == string::npos) {
+            field.clear();
+            return;
+        }
+        field.erase(end + 1);
+        field.erase(0, field.find_first_not_of(" \t"));
+    }
+
+    // Read one row into fields; returns the number of fields seen
+    int readRow(const char*& pos, const char* end, string* fields, size_t& line) const {
+        int count = 0;
+        bool rowDone = false;
+        while (!rowDone) {
+            string scratch;
+            string& field = count < FIELD_COUNT ? fields[count] : scratch;
+            field.clear();
+            bool quoted = false;
+            bool sawDelimiter = false;
+            while (pos < end) {
+                char c = *pos;
+                if (quoted) {
+                    ++pos;
+                    if (c == '"') {
+                        if (pos < end && *pos == '"') {
+                            field.push_back('"');
+                            ++pos;
+                        } else {
+                            quoted = false;
+                        }
+                    } else {
+                        if (c == '\n') {
+                            ++line;
+                        }
+                        field.push_back(c);
+                    }
+                } else if (c == '"') {
+                    quoted = true;
+                    ++pos;
+                } else if (c == delimiter) {
+                    ++pos;
+                    sawDelimiter = true;
+                    break;
+                } else if (c == '\n') {
+                    ++pos;
+                    ++line;
+                    rowDone = true;
+                    break;
+                } else {
+                    if (c != '\r') {
+                        field.push_back(c);
+                    }
+                    ++pos;
+                }
+            }
+            if (pos >= end && !sawDelimiter) {
+                rowDone = true;
+            }
+            trimInPlace(field);
+            ++count;
+        }
+        return count;
+    }
+
+    // Check one row and build its book; returns an error message on failure
+    static string validateRow(string* fields, int fieldCount, Chunk& chunk, size_t line) {
+        if (fieldCount != FIELD_COUNT) {
+            return "expected " + to_string(FIELD_COUNT) + " fields but found " + to_string(fieldCount);
+        }
+        StringArray authors;
+        string authorError;
+        size_t start = 0;
+        while (start <= fields[3].length()) {
+            size_t stop = fields[3].find(';', start);
+            if (stop == string::npos) {
+                stop = fields[3].length();
+            }
+            string author = trimString(fields[3].substr(start, stop - start));
+            if (author.empty() && authorError.empty()) {
+                authorError = "author list '" + fields[3] + "' has an empty name";
+            }
+            authors.push_back(std::move(author));
+            start = stop + 1;
+        }
+
+        string error = checkInternedFields(fields[4], fields[6], authors);
+        if (!error.empty()) {
+            return error;
+        }
+        Book book(fields[0], fields[1], fields[2], authors, fields[4], fields[5], fields[6]);
+        error = validateBook(book);
+        if (!authorError.empty() && (error.empty() || error == "author list has an empty name")) {
+            error = authorError;
+        }
+        if (error.empty()) {
+            chunk.books.push_back(std::move(book));
+            chunk.lines.push_back(line);
+        }
+        return error;
+    }
+
+    void parseChunk(Chunk& chunk, bool firstChunk) const {
+        string fields[FIELD_COUNT];
+        const char* pos = chunk.begin;
+        size_t line = chunk.firstLine;
+        bool firstRow = firstChunk;
+        while (pos < chunk.end) {
+            size_t rowLine = line;
+            int fieldCount = readRow(pos, chunk.end, fields, line);
+            bool header = firstRow && caseInsensitiveCompare(fields[0], "id");
+            firstRow = false;
+            if (header || (fieldCount == 1 && fields[0].empty())) {
+                continue;
+            }
+            string error = validateRow(fields, fieldCount, chunk, rowLine);
+            if (!error.empty()) {
+                chunk.errors.push_back(ImportError{rowLine, std::move(error)});
+            }
+        }
+    }
+
+public:
+    // Constructor
+    BookImporter() : delimiter(','), chunks(nullptr), chunkCount(0) {}
+
+    BookImporter(const BookImporter&) = delete;
+    BookImporter& operator=(const BookImporter&) = delete;
+
+    // Destructor
+    ~BookImporter() {
+        delete[] chunks;
+    }
+
+    // Parse the whole file; returns false if it cannot be read
+    bool parse(const string& path) {
+        if (!file.open(path)) {
+            return false;
+        }
+        const char* begin = file.data();
+        const char* firstLineEnd = static_cast<const char*>(memchr(begin, '\n', file.length()));
+        size_t firstLineLength = firstLineEnd ? static_cast<size_t>(firstLineEnd - begin) : file.length();
+        bool tsv = path.size() >= 4 && caseInsensitiveCompare(path.substr(path.size() - 4), ".tsv");
+        delimiter = tsv || memchr(begin, '\t', firstLineLength) != nullptr ? '\t' : ',';
+
+        size_t threads = thread::hardware_concurrency();
+        size_t byChunkSize = file.length() / MIN_CHUNK_BYTES + 1;
+        if (threads == 0) {
+            threads = 1;
+        }
+        if (threads > byChunkSize) {
+            threads = byChunkSize;
+        }
+        splitChunks(threads);
+
+        thread* workers = new thread[chunkCount];
+        for (size_t i = 1; i < chunkCount; ++i) {
+            workers[i] = thread([this, i]() {
+                parseChunk(chunks[i], false);
+            });
+        }
+        parseChunk(chunks[0], true);
+        for (size_t i = 1; i < chunkCount; ++i) {
+            workers[i].join();
+        }
+        delete[] workers;
+        return true;
+    }
+
+    size_t length() const {
+        return chunkCount;
+    }
+
+    Chunk& operator[](size_t index) {
+        return chunks[index];
+    }
+
+    // Total number of valid rows across all chunks
+    size_t validRows() const {
+        size_t total = 0;
+        for (size_t i = 0; i < chunkCount; ++i) {
+            total += chunks[i].books.length();
+        }
+        return total;
+    }
+};
+
+// Large reusable output buffer over a stdio stream. Output is collected in
+// the buffer and written in big blocks, never flushed per line.
+class OutputBuffer {
+private:
+    static const size_t BUFFER_SIZE = 1 << 20;
+
+    FILE* file;
+    char* buffer;
+    size_t used;
+    bool failed;
+
+public:
+    // Constructor
+    explicit OutputBuffer(FILE* target) : file(target), buffer(new char[BUFFER_SIZE]), used(0), failed(false) {}
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    // Destructor
+    ~OutputBuffer() {
+        flush();
+        delete[] buffer;
+    }
+
+    void write(const char* bytes, size_t count) {
+        if (used + count > BUFFER_SIZE) {
+            flush();
+            if (count > BUFFER_SIZE) {
+                failed = failed || fwrite(bytes, 1, count, file) != count;
+                return;
+            }
+        }
+        memcpy(buffer + used, bytes, count);
+        used += count;
+    }
+
+    void write(string_view text) {
+        write(text.data(), text.length());
+    }
+
+    void put(char c) {
+        if (used == BUFFER_SIZE) {
+            flush();
+        }
+        buffer[used++] = c;
+    }
+
+    // Write count copies of c
+    void fill(char c, size_t count) {
+        while (count > 0) {
+            if (used == BUFFER_SIZE) {
+                flush();
+            }
+            size_t chunk = BUFFER_SIZE - used < count ? BUFFER_SIZE - used : count;
+            memset(buffer + used, c, chunk);
+            used += chunk;
+            count -= chunk;
+        }
+    }
+
+    // Hand the buffered bytes to the stream
+    bool flush() {
+        if (used > 0) {
+            failed = failed || fwrite(buffer, 1, used, file) != used;
+            used = 0;
+        }
+        failed = failed || fflush(file) != 0;
+        return !failed;
+    }
+
+    bool ok() const {
+        return !failed;
+    }
+};
+
+// Large reusable input buffer over a stdio stream that hands out one line
+// at a time. On POSIX systems it takes whatever input has arrived instead
+// of waiting for a full buffer, so a caller can answer the lines received
+// so far (pending() == 0) before blocking for more.
+class LineReader {
+private:
+    static const size_t BUFFER_SIZE = 1 << 20;
+
+    FILE* file;
+    char* buffer;
+    size_t start;
+    size_t end;
+    bool finished;
+
+    // Move the unread bytes to the front and read more after them
+    void refill() {
+        if (start > 0) {
+            memmove(buffer, buffer + start, end - start);
+            end -= start;
+            start = 0;
+        }
+#ifdef LMS_POSIX
+        ssize_t count;
+        do {
+            count = read(fileno(file), buffer + end, BUFFER_SIZE - end);
+        } while (count < 0 && errno == EINTR);
+        if (count <= 0) {
+            finished = true;
+        } else {
+            end += static_cast<size_t>(count);
+        }
+#else
+        size_t count = fread(buffer + end, 1, BUFFER_SIZE - end, file);
+        if (count == 0) {
+            finished = true;
+        }
+        end += count;
+#endif
+    }
+
+public:
+    // Constructor
+    explicit LineReader(FILE* source)
+        : file(source), buffer(new char[BUFFER_SIZE]), start(0), end(0), finished(false) {}
+
+    LineReader(const LineReader&) = delete;
+    LineReader& operator=(const LineReader&) = delete;
+
+    // Destructor
+    ~LineReader() {
+        delete[] buffer;
+    }
+
+    // Read the next line without its line break; false at the end of input.
+    // A line longer than the buffer comes back in buffer-sized pieces.
+    bool next(string& line) {
+        while (true) {
+            const char* newline = static_cast<const char*>(memchr(buffer + start, '\n', end - start));
+            if (newline != nullptr || (finished && start < end) || end - start == BUFFER_SIZE) {
+                size_t stop = newline != nullptr ? static_cast<size_t>(newline - buffer) : end;
+                size_t length = stop - start;
+                if (newline != nullptr && length > 0 && buffer[stop - 1] == '\r') {
+                    --length;
+                }
+                line.assign(buffer + start, length);
+                start = newline != nullptr ? stop + 1 : stop;
+                return true;
+            }
+            if (finished) {
+                return false;
+            }
+            refill();
+        }
+    }
+
+    // Bytes received but not yet handed out
+    size_t pending() const {
+        return end - start;
+    }
+};
+
+// Streams books as CSV (the same layout BookImporter reads) or JSON Lines
+class BookExporter {
+public:
+    enum Format { CSV, JSON_LINES };
+
+private:
+    OutputBuffer& out;
+    Format format;
+
+    void writeCsvField(string_view field) {
+        bool needsQuotes = !field.empty() && (field.front() == ' ' || field.back() == ' ');
+        for (char c : field) {
+            if (c == ',' || c == '"' || c == '\n' || c == '\r' || c == '\t') {
+                needsQuotes = true;
+                break;
+            }
+        }
+        if (!needsQuotes) {
+            out.write(field);
+            return;
+        }
+        out.put('"');
+        for (char c : field) {
+            if (c == '"') {
+                out.put('"');
+            }
+            out.put(c);
+        }
+        out.put('"');
+    }
+
+    void writeJsonString(string_view value) {
+        static const char HEX[] = "0123456789abcdef";
+        out.put('"');
+        for (char c : value) {
+            unsigned char byte = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\') {
+                out.put('\\');
+                out.put(c);
+            } else if (c == '\n') {
+                out.write("\\n", 2);
+            } else if (c == '\r') {
+                out.write("\\r", 2);
+            } else if (c == '\t') {
+                out.write("\\t", 2);
+            } else if (byte < 0x20) {
+                out.write("\\u00", 4);
+                out.put(HEX[byte >> 4]);
+                out.put(HEX[byte & 0xF]);
+            } else {
+                out.put(c);
+            }
+        }
+        out.put('"');
+    }
+
+    void writeJsonField(const char* name, string_view value) {
+        out.put('"');
+        out.write(name, strlen(name));
+        out.write("\":", 2);
+        writeJsonString(value);
+    }
+
+public:
+    BookExporter(OutputBuffer& output, Format layout) : out(output), format(layout) {}
+
+    // Column names for CSV; JSON Lines has none
+    void writeHeader() {
+        if (format == CSV) {
+            const char header[] = "id,isbn,title,authors,edition,publication,category\n";
+            out.write(header, sizeof(header) - 1);
+        }
+    }
+
+    void write(const Book& book) {
+        Book::AuthorList authors = book.getAuthors();
+        if (format == CSV) {
+            writeCsvField(book.getId());
+            out.put(',');
+            writeCsvField(book.getValidIsbn());
+            out.put(',');
+            writeCsvField(book.getTitle());
+            out.put(',');
+            bool quoteAuthors = false;
+            for (string_view author : authors) {
+                quoteAuthors = quoteAuthors || author.find_first_of(",\"\n\r\t") != string_view::npos;
+            }
+            if (quoteAuthors) {
+                out.put('"');
+            }
+            for (size_t i = 0; i < authors.length(); ++i) {
+                if (i > 0) {
+                    out.write("; ", 2);
+                }
+                for (char c : authors[i]) {
+                    if (quoteAuthors && c == '"') {
+                        out.put('"');
+                    }
+                    out.put(c);
+                }
+            }
+            if (quoteAuthors) {
+                out.put('"');
+            }
+            out.put(',');
+            writeCsvField(book.getEdition());
+            out.put(',');
+            writeCsvField(book.getPublication());
+            out.put(',');
+            writeCsvField(book.getCategory());
+            out.put('\n');
+        } else {
+            out.put('{');
+            writeJsonField("id", book.getId());
+            out.put(',');
+            writeJsonField("isbn", book.getValidIsbn());
+            out.put(',');
+            writeJsonField("title", book.getTitle());
+            out.write(",\"authors\":[", 12);
+            for (size_t i = 0; i < authors.length(); ++i) {
+                if (i > 0) {
+                    out.put(',');
+                }
+                writeJsonString(authors[i]);
+            }
+            out.write("],", 2);
+            writeJsonField("edition", book.getEdition());
+            out.put(',');
+            writeJsonField("publication", book.getPublication());
+            out.put(',');
+            writeJsonField("category", book.getCategory());
+            out.write("}\n", 2);
+        }
+    }
+};
+
+// Fixed-width book table rendered straight into an OutputBuffer. Cells are
+// padded in place and long author lists are cut short with "...", so rows
+// are built without temporary strings.
+class BookTable {
+private:
+    struct Column {
+        const char* heading;
+        size_t width;
+    };
+
+    static const int COLUMN_COUNT = 7;
+    static const Column COLUMNS[COLUMN_COUNT];
+
+    OutputBuffer& out;
+
+    void cell(string_view value, size_t width) {
+        out.write(value);
+        if (value.length() < width) {
+            out.fill(' ', width - value.length());
+        }
+    }
+
+    // Authors joined by ", ", cut to leave at least one space before the next column
+    void authorsCell(const Book::AuthorList& authors, size_t width) {
+        size_t total = 0;
+        for (size_t i = 0; i < authors.length(); ++i) {
+            total += authors[i].length() + (i > 0 ? 2 : 0);
+        }
+        size_t limit = total < width ? total : width - 4;
+        size_t written = 0;
+        for (size_t i = 0; i < authors.length(); ++i) {
+            string_view author = authors[i];
+            if (i > 0) {
+                size_t count = limit - written < 2 ? limit - written : 2;
+                out.write(", ", count);
+                written += count;
+            }
+            size_t count = limit - written < author.length() ? limit - written : author.length();
+            out.write(author.data(), count);
+            written += count;
+            if (written == limit) {
+                break;
+            }
+        }
+        if (total >= width) {
+            out.write("...", 3);
+            written += 3;
+        }
+        out.fill(' ', width - written);
+    }
+
+public:
+    explicit BookTable(OutputBuffer& output) : out(output) {}
+
+    void writeHeader() {
+        for (int i = 0; i < COLUMN_COUNT; ++i) {
+            out.write(COLUMNS[i].heading, strlen(COLUMNS[i].heading));
+            out.fill(' ', COLUMNS[i].width - strlen(COLUMNS[i].heading));
+        }
+        out.put('\n');
+    }
+
+    void writeRow(const Book& book) {
+        cell(book.getId(), COLUMNS[0].width);
+        cell(book.getValidIsbn(), COLUMNS[1].width);
+        cell(book.getTitle(), COLUMNS[2].width);
+        authorsCell(book.getAuthors(), COLUMNS[3].width);
+        cell(book.getEdition(), COLUMNS[4].width);
+        cell(book.getPublication(), COLUMNS[5].width);
+        cell(book.getCategory(), COLUMNS[6].width);
+        out.put('\n');
+    }
+};
+
+const BookTable::Column BookTable::COLUMNS[BookTable::COLUMN_COUNT] = {
+    {"ID", 15}, {"ISBN", 15}, {"Title", 20}, {"Authors", 40},
+    {"Edition", 10}, {"Publication", 15}, {"Category", 15}
+};
+
+// Per-category posting lists of store slots. Removing a book only blanks
+// its entry, found through the slot's recorded position, so deletes and
+// category edits are O(1); blanked entries are squeezed out once they
+// outnumber the live ones. Lists are walked in slot order, i.e. the order
+// the books were added. A category with subcategories covers their books
+// too, so its lists are merged when walked.
+class CategoryIndex {
+private:
+    static constexpr int REMOVED = -1;
+    static const size_t MIN_PURGE = 64;
+
+    struct Posting {
+        DynamicArray<int> slots;
+        size_t live;
+        bool sorted;
+
+        Posting() : live(0), sorted(true) {}
+    };
+
+    DynamicArray<Posting> postings;
+    DynamicArray<int> positions;
+    DynamicArray<int> merged;
+
+    // Drop blanked entries and restore slot order
+    void purge(Posting& posting) {
+        size_t next = 0;
+        for (size_t i = 0; i < posting.slots.length(); ++i) {
+            if (posting.slots[i] != REMOVED) {
+                posting.slots[next++] = posting.slots[i];
+            }
+        }
+        posting.slots.resize(next);
+        if (!posting.sorted) {
+            sort(posting.slots.begin(), posting.slots.end());
+            posting.sorted = true;
+        }
+        for (size_t i = 0; i < next; ++i) {
+            positions[static_cast<size_t>(posting.slots[i])] = static_cast<int>(i);
+        }
+    }
+
+public:
+    void add(int slot, uint32_t category) {
+        int code = categoryCodeOf(category);
+        if (code < 0) {
+            return;
+        }
+        size_t list = static_cast<size_t>(code);
+        size_t index = static_cast<size_t>(slot);
+        if (list >= postings.length()) {
+            postings.resize(list + 1);
+        }
+        Posting& posting = postings[list];
+        if (index >= positions.length()) {
+            positions.resize(index + 1, REMOVED);
+        }
+        if (!posting.slots.empty() && posting.slots[posting.slots.length() - 1] > slot) {
+            posting.sorted = false;
+        }
+        positions[index] = static_cast<int>(posting.slots.length());
+        posting.slots.push_back(slot);
+        ++posting.live;
+    }
+
+    void remove(int slot, uint32_t category) {
+        int code = categoryCodeOf(category);
+        size_t index = static_cast<size_t>(slot);
+        if (code < 0 || index >= positions.length() || positions[index] == REMOVED) {
+            return;
+        }
+        Posting& posting = postings[static_cast<size_t>(code)];
+        posting.slots[static_cast<size_t>(positions[index])] = REMOVED;
+        positions[index] = REMOVED;
+        --posting.live;
+        size_t removed = posting.slots.length() - posting.live;
+        if (removed >= MIN_PURGE && removed > posting.live) {
+            purge(posting);
+        }
+    }
+
+    // Follow a book that compaction moved to a lower slot
+    void relocate(int oldSlot, int newSlot, uint32_t category) {
+        int code = categoryCodeOf(category);
+        size_t from = static_cast<size_t>(oldSlot);
+        if (code < 0 || positions[from] == REMOVED) {
+            return;
+        }
+        int position = positions[from];
+        postings[static_cast<size_t>(code)].slots[static_cast<size_t>(position)] = newSlot;
+        positions[static_cast<size_t>(newSlot)] = position;
+        positions[from] = REMOVED;
+    }
+
+    void clear() {
+        postings = DynamicArray<Posting>();
+        positions.clear();
+    }
+
+    // Number of books in a category and its subcategories, in O(1) per
+    // category covered
+    size_t count(string_view category) const {
+        int code = categoryCode(category);
+        if (code < 0) {
+            return 0;
+        }
+        size_t total = 0;
+        size_t last = min(static_cast<size_t>(bookCategories.lastCode(code)) + 1, postings.length());
+        for (size_t i = static_cast<size_t>(code); i < last; ++i) {
+            total += postings[i].live;
+        }
+        return total;
+    }
+
+    // Call visit(slot) for each book in the category or its subcategories
+    // until it returns false
+    template <typename Visit>
+    void forEach(string_view category, Visit visit) {
+        int code = categoryCode(category);
+        if (code < 0 || static_cast<size_t>(code) >= postings.length()) {
+            return;
+        }
+        size_t last = min(static_cast<size_t>(bookCategories.lastCode(code)) + 1, postings.length());
+        if (last == static_cast<size_t>(code) + 1) {
+            Posting& posting = postings[static_cast<size_t>(code)];
+            if (!posting.sorted) {
+                purge(posting);
+            }
+            for (size_t i = 0; i < posting.slots.length(); ++i) {
+                if (posting.slots[i] != REMOVED && !visit(posting.slots[i])) {
+                    return;
+                }
+            }
+            return;
+        }
+        merged.clear();
+        for (size_t i = static_cast<size_t>(code); i < last; ++i) {
+            for (int slot : postings[i].slots) {
+                if (slot != REMOVED) {
+                    merged.push_back(slot);
+                }
+            }
+        }
+        sort(merged.begin(), merged.end());
+        for (int slot : merged) {
+            if (!visit(slot)) {
+                return;
+            }
+        }
+    }
+};
+
+// ISBN lookup. Several copies of a book may share an ISBN, so the hash
+// index points at the first slot with a given canonical ISBN and the rest
+// are chained through per-slot next/previous links.
+class IsbnIndex {
+private:
+    static constexpr int NONE = -1;
+
+    HashIndex<BookIsbnKey> heads;
+    DynamicArray<int> next;
+    DynamicArray<int> previous;
+
+    void ensureSlot(int slot) {
+        if (static_cast<size_t>(slot) >= next.length()) {
+            next.resize(static_cast<size_t>(slot) + 1, NONE);
+            previous.resize(static_cast<size_t>(slot) + 1, NONE);
+        }
+    }
+
+    // Chain links of a slot
+    int& nextOf(int slot) {
+        return next[static_cast<size_t>(slot)];
+    }
+
+    int nextOf(int slot) const {
+        return next[static_cast<size_t>(slot)];
+    }
+
+    int& previousOf(int slot) {
+        return previous[static_cast<size_t>(slot)];
+    }
+
+public:
+    explicit IsbnIndex(const BookStore& store) : heads(store) {}
+
+    void reserve(size_t entries) {
+        heads.reserve(entries);
+    }
+
+    // Index the book at slot, putting it at the front of its ISBN's chain
+    void add(int slot) {
+        ensureSlot(slot);
+        int head = heads.findSlotKey(slot);
+        nextOf(slot) = head;
+        previousOf(slot) = NONE;
+        if (head == NONE) {
+            heads.insert(slot);
+        } else {
+            previousOf(head) = slot;
+            heads.relocate(head, slot);
+        }
+    }
+
+    // Unlink the book at slot; it must still hold the ISBN it was indexed with
+    void remove(int slot) {
+        int before = previousOf(slot);
+        int after = nextOf(slot);
+        if (before != NONE) {
+            nextOf(before) = after;
+        } else if (after != NONE) {
+            heads.relocate(slot, after);
+        } else {
+            heads.erase(slot);
+        }
+        if (after != NONE) {
+            previousOf(after) = before;
+        }
+        nextOf(slot) = NONE;
+        previousOf(slot) = NONE;
+    }
+
+    // Follow a book that compaction moved to a lower slot
+    void relocate(int oldSlot, int newSlot) {
+        int before = previousOf(oldSlot);
+        int after = nextOf(oldSlot);
+        nextOf(newSlot) = after;
+        previousOf(newSlot) = before;
+        if (before != NONE) {
+            nextOf(before) = newSlot;
+        } else {
+            heads.relocate(oldSlot, newSlot);
+        }
+        if (after != NONE) {
+            previousOf(after) = newSlot;
+        }
+        nextOf(oldSlot) = NONE;
+        previousOf(oldSlot) = NONE;
+    }
+
+    void clear() {
+        heads.clear();
+        next.clear();
+        previous.clear();
+    }
+
+    // First slot holding this ISBN (in either form), or -1
+    int first(const string& isbn) const {
+        return heads.find(canonicalIsbn(isbn));
+    }
+
+    // Next slot with the same ISBN, or -1
+    int following(int slot) const {
+        return nextOf(slot);
+    }
+};
+
+// Split text into words and call visit(word) for each one. A word is a run
+// of letters and digits (bytes above 127 count as letters, so accented
+// UTF-8 names stay whole) and is lowercased. word is the caller's buffer.
+template <typename Visit>
+void forEachWord(string_view text, string& word, Visit visit) {
+    size_t i = 0;
+    while (i < text.size()) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (!isalnum(c) && c < 128) {
+            ++i;
+            continue;
+        }
+        size_t start = i;
+        while (i < text.size()) {
+            c = static_cast<unsigned char>(text[i]);
+            if (!isalnum(c) && c < 128) {
+                break;
+            }
+            ++i;
+        }
+        word.assign(text.data() + start, i - start);
+        for (char& letter : word) {
+            if (letter >= 'A' && letter <= 'Z') {
+                letter = static_cast<char>(letter - 'A' + 'a');
+            }
+        }
+        visit(word);
+    }
+}
+
+// Set of distinct strings, each numbered in the order it was first added.
+// The table only holds ids; strings and their hashes live in flat arrays.
+class StringTable {
+private:
+    static constexpr int EMPTY = -1;
+    static const size_t MIN_CAPACITY = 16;
+
+    DynamicArray<string> strings;
+    DynamicArray<size_t> hashes;
+    DynamicArray<int> table;
+
+    // Table position holding str, or the empty position where it belongs
+    size_t locate(const string& str, size_t hash) const {
+        size_t mask = table.length() - 1;
+        size_t position = hash & mask;
+        while (table[position] != EMPTY) {
+            size_t id = static_cast<size_t>(table[position]);
+            if (hashes[id] == hash && strings[id] == str) {
+                break;
+            }
+            position = (position + 1) & mask;
+        }
+        return position;
+    }
+
+    void grow() {
+        size_t newCapacity = table.empty() ? MIN_CAPACITY : table.length() * 2;
+        table.clear();
+        table.resize(newCapacity, EMPTY);
+        size_t mask = newCapacity - 1;
+        for (size_t id = 0; id < strings.length(); ++id) {
+            size_t position = hashes[id] & mask;
+            while (table[position] != EMPTY) {
+                position = (position + 1) & mask;
+            }
+            table[position] = static_cast<int>(id);
+        }
+    }
+
+public:
+    // Id of str, or -1
+    int find(const string& str) const {
+        if (table.empty()) {
+            return EMPTY;
+        }
+        return table[locate(str, stringHash(str))];
+    }
+
+    // Id of str, adding it if it is new
+    int add(const string& str) {
+        if ((strings.length() + 1) * 4 > table.length() * 3) {
+            grow();
+        }
+        size_t hash = stringHash(str);
+        size_t position = locate(str, hash);
+        if (table[position] == EMPTY) {
+            table[position] = static_cast<int>(strings.length());
+            strings.push_back(str);
+            hashes.push_back(hash);
+        }
+        return table[position];
+    }
+
+    const string& operator[](int id) const {
+        return strings[static_cast<size_t>(id)];
+    }
+
+    size_t length() const {
+        return strings.length();
+    }
+
+    void clear() {
+        strings = DynamicArray<string>();
+        hashes.clear();
+        table.clear();
+    }
+};
+
+// A book found by a word search, scored by how often the words occur in it
+struct TextMatch {
+    int slot;
+    uint32_t score;
+};
+
+// Inverted index from the words of titles and author names to the books
+// that contain them. Each word has a posting list of (slot, occurrences)
+// kept in slot order, so a multi-word query walks the shortest list and
+// gallops through the others. Removing or editing a book bumps its slot's
+// version instead of touching the lists: postings with an old version are
+// skipped, and squeezed out once they outnumber the live ones.
+//
+// Besides exact words, a query word can match every word it begins
+// (PREFIX) or every word within a couple of typos (SIMILAR). Prefixes are
+// looked up in a sorted list of the distinct words; similar words are
+// narrowed down through a trigram index before their edit distance is
+// checked. Either way the matching words' postings are merged into one
+// list per query word and intersected as usual.
+//
+// Searching does not change the index once tidy() has sorted the lists
+// that edits appended to out of order, so any number of threads may search
+// it at once while nobody changes it.
+class TextIndex {
+public:
+    enum Mode {EXACT, PREFIX, SIMILAR};
+
+private:
+    static const size_t MIN_PURGE = 64;
+    static const size_t MIN_UNSORTED_WORDS = 256;
+    static const size_t MAX_CHOICES = 256;
+    static const uint32_t MAX_EDITS = 2;
+
+    struct Posting {
+        int slot;
+        uint32_t version;
+        uint32_t count;
+    };
+
+    struct PostingList {
+        DynamicArray<Posting> postings;
+        size_t live;
+        bool sorted;
+
+        PostingList() : live(0), sorted(true) {}
+    };
+
+    // A word that a query word stands for, and how much a match counts
+    struct Choice {
+        int word;
+        uint32_t weight;
+    };
+
+    // Postings matched by one query word, with the weight of each occurrence
+    struct Term {
+        const DynamicArray<Posting>* postings;
+        uint32_t weight;
+        size_t length;
+    };
+
+    StringTable words;
+    DynamicArray<PostingList> lists;
+    DynamicArray<int> unsortedLists;
+    DynamicArray<uint32_t> versions;
+    DynamicArray<int> scratch;
+    string word;
+
+    // Word ids in alphabetical order; words added since the last sort are
+    // the ids from sortedWords.length() on
+    DynamicArray<int> sortedWords;
+
+    // Trigram id -> ids of the words containing it
+    StringTable trigrams;
+    DynamicArray<DynamicArray<int>> trigramWords;
+
+    bool current(const Posting& posting) const {
+        return posting.version == versions[static_cast<size_t>(posting.slot)];
+    }
+
+    // Posting list of a word id
+    PostingList& listOf(int id) {
+        return lists[static_cast<size_t>(id)];
+    }
+
+    const PostingList& listOf(int id) const {
+        return lists[static_cast<size_t>(id)];
+    }
+
+    // Word ids of a book's title and authors, one per occurrence, sorted
+    void collectWords(const Book& book, bool addNew) {
+        scratch.clear();
+        auto collect = [this, addNew](const string& token) {
+            int id = addNew ? addWord(token) : words.find(token);
+            if (id >= 0) {
+                scratch.push_back(id);
+            }
+        };
+        forEachWord(book.getTitle(), word, collect);
+        for (string_view author : book.getAuthors()) {
+            forEachWord(author, word, collect);
+        }
+        sort(scratch.begin(), scratch.end());
+    }
+
+    // Id of a word, adding it and its trigrams if it is new
+    int addWord(const string& token) {
+        size_t known = words.length();
+        int id = words.add(token);
+        if (words.length() > known) {
+            lists.resize(words.length());
+            DynamicArray<string> distinct;
+            collectTrigrams(token, distinct);
+            for (const string& text : distinct) {
+                int trigram = trigrams.add(text);
+                if (static_cast<size_t>(trigram) >= trigramWords.length()) {
+                    trigramWords.resize(static_cast<size_t>(trigram) + 1);
+                }
+                trigramWords[static_cast<size_t>(trigram)].push_back(id);
+            }
+        }
+        return id;
+    }
+
+    // Distinct trigrams of a word padded as "  word ", so its first and
+    // last letters are covered too
+    static void collectTrigrams(const string& token, DynamicArray<string>& distinct) {
+        string padded = "  " + token + " ";
+        distinct.clear();
+        for (size_t i = 0; i + 3 <= padded.size(); ++i) {
+            distinct.push_back(padded.substr(i, 3));
+        }
+        sort(distinct.begin(), distinct.end());
+        distinct.resize(static_cast<size_t>(unique(distinct.begin(), distinct.end()) - distinct.begin()));
+    }
+
+    // Drop outdated postings and restore slot order
+    void purge(PostingList& list) {
+        size_t next = 0;
+        for (size_t i = 0; i < list.postings.length(); ++i) {
+            if (current(list.postings[i])) {
+                list.postings[next++] = list.postings[i];
+            }
+        }
+        list.postings.resize(next);
+        if (!list.sorted) {
+            sort(list.postings.begin(), list.postings.end(), [](const Posting& a, const Posting& b) {
+                return a.slot < b.slot;
+            });
+            list.sorted = true;
+        }
+    }
+
+    // Occurrences of the word in slot, searching forward from position,
+    // which is left at the first posting not before slot. 0 if absent.
+    uint32_t occurrences(const DynamicArray<Posting>& postings, size_t& position, int slot) const {
+        size_t step = 1;
+        size_t low = position;
+        size_t high = position;
+        while (high < postings.length() && postings[high].slot < slot) {
+            low = high + 1;
+            high += step;
+            step *= 2;
+        }
+        if (high > postings.length()) {
+            high = postings.length();
+        }
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (postings[middle].slot < slot) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        position = low;
+        for (size_t i = low; i < postings.length() && postings[i].slot == slot; ++i) {
+            if (current(postings[i])) {
+                return postings[i].count;
+            }
+        }
+        return 0;
+    }
+
+    // Fold words added since the last sort into sortedWords once there
+    // are enough of them that scanning them is no longer cheap
+    void sortNewWords() {
+        size_t sorted = sortedWords.length();
+        if (words.length() - sorted < MIN_UNSORTED_WORDS || (words.length() - sorted) * 8 < sorted) {
+            return;
+        }
+        for (size_t id = sorted; id < words.length(); ++id) {
+            sortedWords.push_back(static_cast<int>(id));
+        }
+        auto alphabetical = [this](int a, int b) {
+            return words[a] < words[b];
+        };
+        sort(sortedWords.begin() + sorted, sortedWords.end(), alphabetical);
+        inplace_merge(sortedWords.begin(), sortedWords.begin() + sorted, sortedWords.end(), alphabetical);
+    }
+
+    static bool startsWith(const string& str, const string& prefix) {
+        return str.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    void addPrefixChoices(const string& prefix, DynamicArray<Choice>& choices) const {
+        const int* first = lower_bound(sortedWords.begin(), sortedWords.end(), prefix, [this](int id, const string& key) {
+            return words[id] < key;
+        });
+        for (const int* it = first; it != sortedWords.end() && startsWith(words[*it], prefix); ++it) {
+            choices.push_back(Choice{*it, 1});
+        }
+        for (size_t id = sortedWords.length(); id < words.length(); ++id) {
+            if (startsWith(words[static_cast<int>(id)], prefix)) {
+                choices.push_back(Choice{static_cast<int>(id), 1});
+            }
+        }
+    }
+
+    // Levenshtein distance between a and b, or limit + 1 if it is larger.
+    // distanceRow is the caller's buffer.
+    static uint32_t editDistance(const string& a, const string& b, uint32_t limit, DynamicArray<uint32_t>& distanceRow) {
+        size_t longer = max(a.size(), b.size());
+        if (longer - min(a.size(), b.size()) > limit) {
+            return limit + 1;
+        }
+        distanceRow.resize(b.size() + 1);
+        for (size_t j = 0; j <= b.size(); ++j) {
+            distanceRow[j] = static_cast<uint32_t>(j);
+        }
+        for (size_t i = 1; i <= a.size(); ++i) {
+            uint32_t diagonal = distanceRow[0];
+            distanceRow[0] = static_cast<uint32_t>(i);
+            uint32_t best = distanceRow[0];
+            for (size_t j = 1; j <= b.size(); ++j) {
+                uint32_t above = distanceRow[j];
+                uint32_t cost = a[i - 1] == b[j - 1] ? 0 : 1;
+                distanceRow[j] = min(min(above, distanceRow[j - 1]) + 1, diagonal + cost);
+                diagonal = above;
+                best = min(best, distanceRow[j]);
+            }
+            if (best > limit) {
+                return limit + 1;
+            }
+        }
+        return min(distanceRow[b.size()], limit + 1);
+    }
+
+    // Words within a few edits of token: none for up to 2 letters, 1 for
+    // up to 5 and MAX_EDITS beyond. Closer words get a higher weight.
+    void addSimilarChoices(const string& token, DynamicArray<Choice>& choices) const {
+        uint32_t limit = token.size() <= 2 ? 0 : token.size() <= 5 ? 1 : MAX_EDITS;
+        if (limit == 0) {
+            int id = words.find(token);
+            if (id >= 0) {
+                choices.push_back(Choice{id, MAX_EDITS + 1});
+            }
+            return;
+        }
+
+        // Each edit breaks at most three trigrams, so a candidate must share
+        // the rest; when that leaves no bound, every word is a candidate.
+        // The per-word counts belong to the searching thread and are left
+        // at zero.
+        static thread_local DynamicArray<uint16_t> sharedTrigrams;
+        DynamicArray<string> distinct;
+        collectTrigrams(token, distinct);
+        size_t needed = distinct.length() > 3 * limit ? distinct.length() - 3 * limit : 0;
+        DynamicArray<int> ids;
+        for (const string& text : distinct) {
+            ids.push_back(trigrams.find(text));
+        }
+        DynamicArray<int> candidates;
+        if (needed == 0) {
+            for (size_t id = 0; id < words.length(); ++id) {
+                candidates.push_back(static_cast<int>(id));
+            }
+        } else {
+            if (sharedTrigrams.length() < words.length()) {
+                sharedTrigrams.resize(words.length(), 0);
+            }
+            for (int trigram : ids) {
+                if (trigram < 0) {
+                    continue;
+                }
+                for (int id : trigramWords[static_cast<size_t>(trigram)]) {
+                    if (++sharedTrigrams[static_cast<size_t>(id)] == needed) {
+                        candidates.push_back(id);
+                    }
+                }
+            }
+            for (int trigram : ids) {
+                if (trigram >= 0) {
+                    for (int id : trigramWords[static_cast<size_t>(trigram)]) {
+                        sharedTrigrams[static_cast<size_t>(id)] = 0;
+                    }
+                }
+            }
+        }
+
+        DynamicArray<uint32_t> distanceRow;
+        for (int id : candidates) {
+            uint32_t distance = editDistance(token, words[id], limit, distanceRow);
+            if (distance <= limit) {
+                choices.push_back(Choice{id, MAX_EDITS + 1 - distance});
+            }
+        }
+    }
+
+    // Words a query word matches in the given mode, keeping only the
+    // MAX_CHOICES most common so a short prefix stays fast
+    void findChoices(const string& token, Mode mode, DynamicArray<Choice>& choices) const {
+        choices.clear();
+        if (mode == PREFIX) {
+            addPrefixChoices(token, choices);
+        } else if (mode == SIMILAR) {
+            addSimilarChoices(token, choices);
+        } else {
+            int id = words.find(token);
+            if (id >= 0) {
+                choices.push_back(Choice{id, 1});
+            }
+        }
+        if (choices.length() > MAX_CHOICES) {
+            nth_element(choices.begin(), choices.begin() + MAX_CHOICES, choices.end(),
+                        [this](const Choice& a, const Choice& b) {
+                return a.weight != b.weight ? a.weight > b.weight : listOf(a.word).live > listOf(b.word).live;
+            });
+            choices.resize(MAX_CHOICES);
+        }
+    }
+
+    // Merge the postings of several words into one list of weighted counts
+    void mergePostings(const DynamicArray<Choice>& choices, DynamicArray<Posting>& merged) const {
+        for (const Choice& choice : choices) {
+            for (const Posting& posting : listOf(choice.word).postings) {
+                if (current(posting)) {
+                    merged.push_back(Posting{posting.slot, posting.version, posting.count * choice.weight});
+                }
+            }
+        }
+        sort(merged.begin(), merged.end(), [](const Posting& a, const Posting& b) {
+            return a.slot < b.slot;
+        });
+        size_t next = 0;
+        for (size_t i = 0; i < merged.length(); ++i) {
+            if (next > 0 && merged[next - 1].slot == merged[i].slot) {
+                merged[next - 1].count += merged[i].count;
+            } else {
+                merged[next++] = merged[i];
+            }
+        }
+        merged.resize(next);
+    }
+
+public:
+    // Index the words of the book at slot
+    void add(int slot, const Book& book) {
+        if (static_cast<size_t>(slot) >= versions.length()) {
+            versions.resize(static_cast<size_t>(slot) + 1, 0);
+        }
+        collectWords(book, true);
+        for (size_t i = 0; i < scratch.length();) {
+            size_t end = i;
+            while (end < scratch.length() && scratch[end] == scratch[i]) {
+                ++end;
+            }
+            PostingList& list = listOf(scratch[i]);
+            if (list.sorted && !list.postings.empty() && list.postings[list.postings.length() - 1].slot > slot) {
+                list.sorted = false;
+                unsortedLists.push_back(scratch[i]);
+            }
+            list.postings.push_back(Posting{slot, versions[static_cast<size_t>(slot)], static_cast<uint32_t>(end - i)});
+            ++list.live;
+            i = end;
+        }
+        sortNewWords();
+    }
+
+    // Unindex the book at slot; it must still hold the words it was indexed with
+    void remove(int slot, const Book& book) {
+        collectWords(book, false);
+        ++versions[static_cast<size_t>(slot)];
+        for (size_t i = 0; i < scratch.length(); ++i) {
+            if (i > 0 && scratch[i] == scratch[i - 1]) {
+                continue;
+            }
+            PostingList& list = listOf(scratch[i]);
+            --list.live;
+            size_t stale = list.postings.length() - list.live;
+            if (stale >= MIN_PURGE && stale > list.live) {
+                purge(list);
+            }
+        }
+    }
+
+    // Whether search() may be called: no list is waiting to be sorted
+    bool isTidy() const {
+        return unsortedLists.empty();
+    }
+
+    // Sort the lists that books were added to out of slot order
+    void tidy() {
+        for (int id : unsortedLists) {
+            if (!listOf(id).sorted) {
+                purge(listOf(id));
+            }
+        }
+        unsortedLists.clear();
+    }
+
+    void clear() {
+        words.clear();
+        lists = DynamicArray<PostingList>();
+        unsortedLists.clear();
+        versions.clear();
+        sortedWords.clear();
+        trigrams.clear();
+        trigramWords = DynamicArray<DynamicArray<int>>();
+    }
+
+    // Books matching every word of the query, highest score first and in
+    // slot order among equal scores. The score adds up the occurrences of
+    // the matched words; in SIMILAR mode an exact word counts three times
+    // and a word one edit away twice. The index must be tidy.
+    DynamicArray<TextMatch> search(const string& query, Mode mode = EXACT) const {
+        DynamicArray<TextMatch> matches;
+        StringArray tokens;
+        string buffer;
+        forEachWord(query, buffer, [&tokens](const string& token) {
+            for (const string& seen : tokens) {
+                if (seen == token) {
+                    return;
+                }
+            }
+            tokens.push_back(token);
+        });
+        if (tokens.empty()) {
+            return matches;
+        }
+
+        // One term per query word: a single word's own list, or the merged
+        // postings of all the words it matches
+        DynamicArray<Term> terms;
+        DynamicArray<DynamicArray<Posting>> merged;
+        DynamicArray<Choice> choices;
+        merged.reserve(tokens.length());
+        for (const string& token : tokens) {
+            findChoices(token, mode, choices);
+            if (choices.empty()) {
+                return matches;
+            }
+            if (choices.length() == 1) {
+                const PostingList& list = listOf(choices[0].word);
+                terms.push_back(Term{&list.postings, choices[0].weight, list.live});
+            } else {
+                merged.push_back(DynamicArray<Posting>());
+                DynamicArray<Posting>& postings = merged[merged.length() - 1];
+                mergePostings(choices, postings);
+                terms.push_back(Term{&postings, 1, postings.length()});
+            }
+        }
+        sort(terms.begin(), terms.end(), [](const Term& a, const Term& b) {
+            return a.length < b.length;
+        });
+
+        // Walk the shortest term and gallop through the others
+        DynamicArray<size_t> positions;
+        positions.resize(terms.length(), 0);
+        const DynamicArray<Posting>& shortest = *terms[0].postings;
+        for (size_t i = 0; i < shortest.length(); ++i) {
+            if (!current(shortest[i])) {
+                continue;
+            }
+            uint32_t score = shortest[i].count * terms[0].weight;
+            for (size_t j = 1; j < terms.length() && score > 0; ++j) {
+                uint32_t count = occurrences(*terms[j].postings, positions[j], shortest[i].slot);
+                score = count == 0 ? 0 : score + count * terms[j].weight;
+            }
+            if (score > 0) {
+                matches.push_back(TextMatch{shortest[i].slot, score});
+            }
+        }
+        sort(matches.begin(), matches.end(), [](const TextMatch& a, const TextMatch& b) {
+            return a.score != b.score ? a.score > b.score : a.slot < b.slot;
+        });
+        return matches;
+    }
+};
+
+// B+ tree of store slots kept in the order given by OrderTraits, with the
+// slot number breaking ties. Keys are read from the store, so leaves only
+// hold slots; branches also keep the size and lowest slot of each child
+// for counting and searching. Leaves are chained left to right, so a range
+// is found in O(log n) and walked in O(k).
+//
+// The tree is built from the store on first use (build()); until then
+// insert() and erase() do nothing, so orders nobody looks at cost nothing.
+template <typename OrderTraits>
+class OrderedIndex {
+private:
+    static const int LEAF_CAPACITY = 64;
+    static const int BRANCH_CAPACITY = 32;
+
+    struct Node {
+        bool leaf;
+        int count;
+    };
+
+    struct Leaf : Node {
+        Leaf* next;
+        int slots[LEAF_CAPACITY];
+    };
+
+    struct Branch : Node {
+        Node* children[BRANCH_CAPACITY];
+        size_t sizes[BRANCH_CAPACITY];
+        int lows[BRANCH_CAPACITY];
+    };
+
+    const BookStore& store;
+    Node* root;
+    size_t size;
+    bool built;
+
+    bool before(int a, int b) const {
+        int order = OrderTraits::compare(store[static_cast<size_t>(a)], store[static_cast<size_t>(b)]);
+        return order != 0 ? order < 0 : a < b;
+    }
+
+    static Leaf* newLeaf() {
+        Leaf* leaf = new Leaf;
+        leaf->leaf = true;
+        leaf->count = 0;
+        leaf->next = nullptr;
+        return leaf;
+    }
+
+    static Branch* newBranch() {
+        Branch* branch = new Branch;
+        branch->leaf = false;
+        branch->count = 0;
+        return branch;
+    }
+
+    static void destroy(Node* node) {
+        if (node == nullptr) {
+            return;
+        }
+        if (node->leaf) {
+            delete static_cast<Leaf*>(node);
+            return;
+        }
+        Branch* branch = static_cast<Branch*>(node);
+        for (int i = 0; i < branch->count; ++i) {
+            destroy(branch->children[i]);
+        }
+        delete branch;
+    }
+
+    static int lowest(const Node* node) {
+        return node->leaf ? static_cast<const Leaf*>(node)->slots[0] : static_cast<const Branch*>(node)->lows[0];
+    }
+
+    static size_t subtreeSize(const Node* node) {
+        if (node->leaf) {
+            return static_cast<size_t>(node->count);
+        }
+        const Branch* branch = static_cast<const Branch*>(node);
+        size_t total = 0;
+        for (int i = 0; i < branch->count; ++i) {
+            total += branch->sizes[i];
+        }
+        return total;
+    }
+
+    // Number of leading entries for which below(slot) holds
+    template <typename Below>
+    static int countBelow(const int* slots, int count, Below below) {
+        return static_cast<int>(partition_point(slots, slots + count, below) - slots);
+    }
+
+    // Child of a branch whose range takes in slot
+    int childFor(const Branch* branch, int slot) const {
+        int index = countBelow(branch->lows, branch->count, [this, slot](int low) {
+            return !before(slot, low);
+        });
+        return index > 0 ? index - 1 : 0;
+    }
+
+    // Insert into a subtree; returns the new right sibling if the node split
+    Node* insertInto(Node* node, int slot) {
+        if (node->leaf) {
+            Leaf* leaf = static_cast<Leaf*>(node);
+            int position = countBelow(leaf->slots, leaf->count, [this, slot](int other) {
+                return before(other, slot);
+            });
+            copy_backward(leaf->slots + position, leaf->slots + leaf->count, leaf->slots + leaf->count + 1);
+            leaf->slots[position] = slot;
+            if (++leaf->count < LEAF_CAPACITY) {
+                return nullptr;
+            }
+            Leaf* right = newLeaf();
+            int half = leaf->count / 2;
+            right->count = leaf->count - half;
+            copy(leaf->slots + half, leaf->slots + leaf->count, right->slots);
+            leaf->count = half;
+            right->next = leaf->next;
+            leaf->next = right;
+            return right;
+        }
+
+        Branch* branch = static_cast<Branch*>(node);
+        int index = childFor(branch, slot);
+        Node* split = insertInto(branch->children[index], slot);
+        ++branch->sizes[index];
+        branch->lows[index] = lowest(branch->children[index]);
+        if (split == nullptr) {
+            return nullptr;
+        }
+        size_t splitSize = subtreeSize(split);
+        branch->sizes[index] -= splitSize;
+        int end = branch->count;
+        copy_backward(branch->children + index + 1, branch->children + end, branch->children + end + 1);
+        copy_backward(branch->sizes + index + 1, branch->sizes + end, branch->sizes + end + 1);
+        copy_backward(branch->lows + index + 1, branch->lows + end, branch->lows + end + 1);
+        branch->children[index + 1] = split;
+        branch->sizes[index + 1] = splitSize;
+        branch->lows[index + 1] = lowest(split);
+        if (++branch->count < BRANCH_CAPACITY) {
+            return nullptr;
+        }
+        Branch* right = newBranch();
+        int half = branch->count / 2;
+        right->count = branch->count - half;
+        copy(branch->children + half, branch->children + branch->count, right->children);
+        copy(branch->sizes + half, branch->sizes + branch->count, right->sizes);
+        copy(branch->lows + half, branch->lows + branch->count, right->lows);
+        branch->count = half;
+        return right;
+    }
+
+    // Join the child at index + 1 into the child at index if both fit in one node
+    void mergeChildren(Branch* branch, int index) {
+        Node* left = branch->children[index];
+        Node* right = branch->children[index + 1];
+        int capacity = left->leaf ? LEAF_CAPACITY : BRANCH_CAPACITY;
+        if (left->count + right->count >= capacity) {
+            return;
+        }
+        if (left->leaf) {
+            Leaf* a = static_cast<Leaf*>(left);
+            Leaf* b = static_cast<Leaf*>(right);
+            copy(b->slots, b->slots + b->count, a->slots + a->count);
+            a->next = b->next;
+            a->count += b->count;
+            delete b;
+        } else {
+            Branch* a = static_cast<Branch*>(left);
+            Branch* b = static_cast<Branch*>(right);
+            copy(b->children, b->children + b->count, a->children + a->count);
+            copy(b->sizes, b->sizes + b->count, a->sizes + a->count);
+            copy(b->lows, b->lows + b->count, a->lows + a->count);
+            a->count += b->count;
+            delete b;
+        }
+        branch->sizes[index] += branch->sizes[index + 1];
+        branch->lows[index] = lowest(left);
+        int end = branch->count;
+        copy(branch->children + index + 2, branch->children + end, branch->children + index + 1);
+        copy(branch->sizes + index + 2, branch->sizes + end, branch->sizes + index + 1);
+        copy(branch->lows + index + 2, branch->lows + end, branch->lows + index + 1);
+        --branch->count;
+    }
+
+    // Remove slot from a subtree. Children that fall below a quarter full
+    // are merged with a neighbour when the two fit in one node.
+    void eraseFrom(Node* node, int slot) {
+        if (node->leaf) {
+            Leaf* leaf = static_cast<Leaf*>(node);
+            int position = countBelow(leaf->slots, leaf->count, [this, slot](int other) {
+                return before(other, slot);
+            });
+            copy(leaf->slots + position + 1, leaf->slots + leaf->count, leaf->slots + position);
+            --leaf->count;
+            return;
+        }
+
+        Branch* branch = static_cast<Branch*>(node);
+        int index = childFor(branch, slot);
+        Node* child = branch->children[index];
+        eraseFrom(child, slot);
+        --branch->sizes[index];
+        if (child->count > 0) {
+            branch->lows[index] = lowest(child);
+        }
+        int capacity = child->leaf ? LEAF_CAPACITY : BRANCH_CAPACITY;
+        if (child->count < capacity / 4 && branch->count > 1) {
+            if (index + 1 < branch->count) {
+                mergeChildren(branch, index);
+            } else {
+                mergeChildren(branch, index - 1);
+            }
+        }
+    }
+
+    // Fix up slot numbers after the store was compacted
+    static void renumberNode(Node* node, const DynamicArray<int>& newSlots) {
+        if (node->leaf) {
+            Leaf* leaf = static_cast<Leaf*>(node);
+            for (int i = 0; i < leaf->count; ++i) {
+                leaf->slots[i] = newSlots[static_cast<size_t>(leaf->slots[i])];
+            }
+            return;
+        }
+        Branch* branch = static_cast<Branch*>(node);
+        for (int i = 0; i < branch->count; ++i) {
+            branch->lows[i] = newSlots[static_cast<size_t>(branch->lows[i])];
+            renumberNode(branch->children[i], newSlots);
+        }
+    }
+
+public:
+    // Position in the index, moving left to right through the leaves
+    class Cursor {
+    private:
+        const Leaf* leaf;
+        int index;
+
+        friend class OrderedIndex;
+
+        Cursor(const Leaf* start, int position) : leaf(start), index(position) {
+            settle();
+        }
+
+        // Step over the end of a leaf onto the next one
+        void settle() {
+            while (leaf != nullptr && index >= leaf->count) {
+                leaf = leaf->next;
+                index = 0;
+            }
+        }
+
+    public:
+        bool valid() const {
+            return leaf != nullptr;
+        }
+
+        int slot() const {
+            return leaf->slots[index];
+        }
+
+        void advance() {
+            ++index;
+            settle();
+        }
+    };
+
+    explicit OrderedIndex(const BookStore& books) : store(books), root(nullptr), size(0), built(false) {}
+
+    OrderedIndex(const OrderedIndex&) = delete;
+    OrderedIndex& operator=(const OrderedIndex&) = delete;
+
+    ~OrderedIndex() {
+        destroy(root);
+    }
+
+    bool isBuilt() const {
+        return built;
+    }
+
+    // Sort every live book and pack the tree bottom-up, leaves three
+    // quarters full so later inserts rarely split
+    void build() {
+        clear();
+        DynamicArray<int> slots;
+        slots.reserve(store.length());
+        for (size_t i = 0; i < store.slotCount(); ++i) {
+            if (store.isLive(i)) {
+                slots.push_back(static_cast<int>(i));
+            }
+        }
+        sort(slots.begin(), slots.end(), [this](int a, int b) {
+            return before(a, b);
+        });
+
+        // The last node made is the root once a level holds only one
+        DynamicArray<Node*> level;
+        Node* top = nullptr;
+        const int leafFill = LEAF_CAPACITY * 3 / 4;
+        Leaf* previous = nullptr;
+        for (size_t i = 0; i < slots.length() || level.empty(); i += leafFill) {
+            Leaf* leaf = newLeaf();
+            size_t end = min(slots.length(), i + leafFill);
+            for (size_t j = i; j < end; ++j) {
+                leaf->slots[leaf->count++] = slots[j];
+            }
+            if (previous != nullptr) {
+                previous->next = leaf;
+            }
+            previous = leaf;
+            level.push_back(leaf);
+            top = leaf;
+        }
+
+        const int branchFill = BRANCH_CAPACITY * 3 / 4;
+        while (level.length() > 1) {
+            DynamicArray<Node*> parents;
+            for (size_t i = 0; i < level.length(); i += branchFill) {
+                Branch* branch = newBranch();
+                size_t end = min(level.length(), i + branchFill);
+                for (size_t j = i; j < end; ++j) {
+                    branch->children[branch->count] = level[j];
+                    branch->sizes[branch->count] = subtreeSize(level[j]);
+                    branch->lows[branch->count] = lowest(level[j]);
+                    ++branch->count;
+                }
+                parents.push_back(branch);
+                top = branch;
+            }
+            level = std::move(parents);
+        }
+        root = top;
+        size = slots.length();
+        built = true;
+    }
+
+    // Forget the tree; it is built again on next use
+    void clear() {
+        destroy(root);
+        root = nullptr;
+        size = 0;
+        built = false;
+    }
+
+    void insert(int slot) {
+        if (!built) {
+            return;
+        }
+        Node* split = insertInto(root, slot);
+        if (split != nullptr) {
+            Branch* branch = newBranch();
+            branch->children[0] = root;
+            branch->sizes[0] = subtreeSize(root);
+            branch->lows[0] = lowest(root);
+            branch->children[1] = split;
+            branch->sizes[1] = subtreeSize(split);
+            branch->lows[1] = lowest(split);
+            branch->count = 2;
+            root = branch;
+        }
+        ++size;
+    }
+
+    // Remove the book at slot; it must still hold the key it was indexed with
+    void erase(int slot) {
+        if (!built) {
+            return;
+        }
+        eraseFrom(root, slot);
+        --size;
+        while (!root->leaf && root->count == 1) {
+            Branch* branch = static_cast<Branch*>(root);
+            root = branch->children[0];
+            delete branch;
+        }
+    }
+
+    // Follow the store's compaction; newSlots maps each old slot to its new one
+    void renumber(const DynamicArray<int>& newSlots) {
+        if (built && size > 0) {
+            renumberNode(root, newSlots);
+        }
+    }
+
+    size_t length() const {
+        return size;
+    }
+
+    // First book in order
+    Cursor first() const {
+        const Node* node = root;
+        while (!node->leaf) {
+            node = static_cast<const Branch*>(node)->children[0];
+        }
+        return Cursor(static_cast<const Leaf*>(node), 0);
+    }
+
+    // First book for which below(slot) fails. below must hold for a
+    // leading run of the order and fail for the rest.
+    template <typename Below>
+    Cursor seek(Below below) const {
+        const Node* node = root;
+        while (!node->leaf) {
+            const Branch* branch = static_cast<const Branch*>(node);
+            int index = countBelow(branch->lows, branch->count, below);
+            node = branch->children[index > 0 ? index - 1 : 0];
+        }
+        const Leaf* leaf = static_cast<const Leaf*>(node);
+        return Cursor(leaf, countBelow(leaf->slots, leaf->count, below));
+    }
+
+    // Number of books for which below(slot) holds, in O(log n)
+    template <typename Below>
+    size_t rankOf(Below below) const {
+        size_t total = 0;
+        const Node* node = root;
+        while (!node->leaf) {
+            const Branch* branch = static_cast<const Branch*>(node);
+            int index = countBelow(branch->lows, branch->count, below);
+            if (index == 0) {
+                return total;
+            }
+            for (int i = 0; i < index - 1; ++i) {
+                total += branch->sizes[i];
+            }
+            node = branch->children[index - 1];
+        }
+        const Leaf* leaf = static_cast<const Leaf*>(node);
+        return total + static_cast<size_t>(countBelow(leaf->slots, leaf->count, below));
+    }
+
+    // First book whose key is at least bound (counting keys that begin with it)
+    Cursor lowerBound(const string& bound) const {
+        return seek([this, &bound](int slot) {
+            return OrderTraits::compareKey(store[slot], bound, true) < 0;
+        });
+    }
+
+    // Number of books whose key is below bound, or up to and including
+    // bound when inclusive is set
+    size_t rank(const string& bound, bool inclusive) const {
+        return rankOf([this, &bound, inclusive](int slot) {
+            int order = OrderTraits::compareKey(store[static_cast<size_t>(slot)], bound, true);
+            return inclusive ? order <= 0 : order < 0;
+        });
+    }
+
+    // Book at a position in the order, in O(log n); invalid past the end
+    Cursor at(size_t position) const {
+        if (position >= size) {
+            return Cursor(nullptr, 0);
+        }
+        const Node* node = root;
+        while (!node->leaf) {
+            const Branch* branch = static_cast<const Branch*>(node);
+            int index = 0;
+            while (position >= branch->sizes[index]) {
+                position -= branch->sizes[index++];
+            }
+            node = branch->children[index];
+        }
+        return Cursor(static_cast<const Leaf*>(node), static_cast<int>(position));
+    }
+
+    // Whether the book at slot comes no later than a book with this key and
+    // sequence number. Slots grow with sequence numbers, so this agrees with
+    // the tree order even after that book is gone.
+    bool notAfter(int slot, const string& key, uint64_t sequence) const {
+        int order = OrderTraits::compareKey(store[static_cast<size_t>(slot)], key);
+        return order != 0 ? order < 0 : store.sequence(static_cast<size_t>(slot)) <= sequence;
+    }
+
+    // Position just past the book with this key and sequence number
+    Cursor after(const string& key, uint64_t sequence) const {
+        return seek([this, &key, sequence](int slot) {
+            return notAfter(slot, key, sequence);
+        });
+    }
+
+    size_t rankAfter(const string& key, uint64_t sequence) const {
+        return rankOf([this, &key, sequence](int slot) {
+            return notAfter(slot, key, sequence);
+        });
+    }
+};
+
+// Batch command format. Fields are separated by '|' and authors by ';';
+// a backslash makes the next character literal, so values may contain
+// either separator. Line breaks are written as \n and \r so every record
+// stays on one line. Books are written back in the same layout:
+//   id|isbn|title|author1;author2|edition|publication|category
+
+// Append a value, escaping backslashes, separators and line breaks
+void appendEscaped(string& out, string_view value) {
+    for (char c : value) {
+        if (c == '\n') {
+            out += "\\n";
+            continue;
+        }
+        if (c == '\r') {
+            out += "\\r";
+            continue;
+        }
+        if (c == '\\' || c == '|' || c == ';') {
+            out += '\\';
+        }
+        out += c;
+    }
+}
+
+void appendRecord(string& out, const Book& book) {
+    appendEscaped(out, book.getId());
+    out += '|';
+    appendEscaped(out, book.getValidIsbn());
+    out += '|';
+    appendEscaped(out, book.getTitle());
+    out += '|';
+    Book::AuthorList authors = book.getAuthors();
+    for (size_t i = 0; i < authors.length(); ++i) {
+        if (i > 0) {
+            out += ';';
+        }
+        appendEscaped(out, authors[i]);
+    }
+    out += '|';
+    appendEscaped(out, book.getEdition());
+    out += '|';
+    appendEscaped(out, book.getPublication());
+    out += '|';
+    appendEscaped(out, book.getCategory());
+    out += '\n';
+}
+
+// Split text at each separator not escaped by a backslash. Escapes are
+// kept so the pieces can be split again; unescapeField() removes them.
+void splitEscaped(const string& text, char separator, DynamicArray<string>& parts) {
+    parts.clear();
+    string part;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\\' && i + 1 < text.size()) {
+            part += text[i];
+            part += text[++i];
+        } else if (text[i] == separator) {
+            parts.push_back(std::move(part));
+            part.clear();
+        } else {
+            part += text[i];
+        }
+    }
+    parts.push_back(std::move(part));
+}
+
+string unescapeField(const string& text) {
+    string value;
+    value.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\\' && i + 1 < text.size()) {
+            ++i;
+            value += text[i] == 'n' ? '\n' : text[i] == 'r' ? '\r' : text[i];
+        } else {
+            value += text[i];
+        }
+    }
+    return trimString(value);
+}
+
+// One page of a listing: the slots of its books, the position of the first
+// of them in the whole listing, the listing's length, and a cursor naming
+// where the next page starts (empty on the last page). A cursor holds the
+// sort key and sequence number of the last book shown, so it stays valid
+// while books are added, edited, deleted or compacted.
+struct BookPage {
+    DynamicArray<int> slots;
+    size_t first;
+    size_t total;
+    string next;
+
+    BookPage() : first(0), total(0) {}
+};
+
+class LibraryManagementSystem {
+    friend class CatalogBenchmark;
+    friend class SelfTest;
+
+public:
+    enum ListOrder {BY_ADDED, BY_TITLE, BY_ID, BY_YEAR, BY_EDITION};
+
+    // The result of a change that was made but could not be saved
+    static constexpr const char* UNSAVED_RESULT = "ERR could not save changes\n";
+
+private:
+    static const size_t INITIAL_BOOKS = 1024;
+    static const size_t MIN_COMPACT_SLOTS = 1024;
+    static const uint64_t CHECKPOINT_RECORDS = 10000;
+    static const size_t MAX_SHOWN_IMPORT_ERRORS = 20;
+    static const size_t PAGE_SIZE = 25;
+    static const size_t RECORD_FIELDS = 7;
+    static const size_t MAX_BATCH_GROUP = 4096;
+    static const size_t MAX_BATCH_PAGE = 100000;
+    BookStore books;
+    HashIndex<BookIdKey> idIndex;
+    CategoryIndex categoryIndex;
+    IsbnIndex isbnIndex;
+    OrderedIndex<BookAddedOrder> addedOrder;
+    OrderedIndex<BookTitleOrder> titleOrder;
+    OrderedIndex<BookIdOrder> idOrder;
+    OrderedIndex<BookYearOrder> yearOrder;
+    OrderedIndex<BookEditionOrder> editionOrder;
+    TextIndex textIndex;
+    bool textIndexed;
+    string catalogPath;
+    bool replica;
+    bool abandoned;
+    Journal journal;
+    OutputBuffer screen;
+    BookTable table;
+
+    // Input Validation Methods 
+    bool isIdUnique(string_view id) const {
+        return idIndex.find(id) == -1;
+    }
+
+    string getValidIsbn() {
         string isbn;
         bool validInput = false;
         
         do {
-            cout << "Enter ISBN (10 or 13 digits, 'x' allowed): ";
-            getline(cin, isbn);
-            isbn = trimString(isbn);
+            cout << "Enter ISBN (10 or 13 digits, 'x' allowed): ";
+            getline(cin, isbn);
+            isbn = trimString(isbn);
+            
+            if (isbn.empty()) {
+                cout << "ISBN cannot be empty. Please try again.\n";
+                continue;
+            }
+            
+            // Check if ISBN contains only digits and 'x'
+            IsbnCheck check = checkIsbn(isbn);
+            if (check == ISBN_BAD_CHARACTERS) {
+                cout << "Invalid ISBN! ISBN must contain only digits and 'x'.\n";
+                continue;
+            }
+            
+            // Check if the ISBN has the correct number of digits (10 or 13)
+            if (check == ISBN_BAD_LENGTH) {
+                cout << "Invalid ISBN! ISBN must contain exactly 10 or 13 characters (digits and 'x').\n";
+                continue;
+            }
+            
+            validInput = true;
+            
+        } while (!validInput);
+        
+        return isbn;
+    }
+
+    string getValidInput(const string& prompt, bool allowEmpty = false) {
+        string input;
+        bool validInput = false;
+        
+        do {
+            cout << prompt;
+            getline(cin, input);
+            input = trimString(input);
+            
+            if (!input.empty() || allowEmpty) {
+                validInput = true;
+            } else {
+                cout << "Input cannot be empty. Please try again.\n";
+            }
+        } while (!validInput);
+        
+        return input;
+    }
+    
+    string getValidId() {
+        string id;
+        bool validInput = false;
+        
+        do {
+            id = getValidInput("Enter Book ID: ");
+            
+            if (!isValidId(id)) {
+                cout << "Invalid ID! ID must be alphanumeric.\n";
+                continue;
+            }
+            
+            if (!isIdUnique(id)) {
+                cout << "Duplicate ID! Please enter a unique ID.\n";
+                continue;
+            }
+            
+            validInput = true;
+        } while (!validInput);
+        
+        return id;
+    }
+    
+    string getValidCategory() {
+        string category;
+        bool validInput = false;
+        
+        do {
+            category = getValidInput(bookCategories.isBuiltIn() ? "Enter Book Category (Fiction/Non-fiction): "
+                                                                : "Enter Book Category: ");
+            
+            // Normalize category to maintain consistency
+            if (normalizeCategory(category, category)) {
+                validInput = true;
+            } else {
+                cout << "Category not found! Please enter a valid category.\n";
+            }
+        } while (!validInput);
+        
+        return category;
+    }
+    
+    string getValidPublication() {
+        string publication;
+        bool validInput = false;
+        
+        do {
+            publication = getValidInput("Enter Publication Year (4 digits): ");
+            
+            // Check if the input is a 4-digit year 
+            YearCheck check = checkPublicationYear(publication);
+            if (check == YEAR_OK) {
+                validInput = true;
+            } else if (check == YEAR_OUT_OF_RANGE) {
+                cout << "Invalid year! Year must be between 1000 and 2100.\n";
+            } else {
+                cout << "Invalid publication year! Publication must be a 4-digit year.\n";
+            }
+        } while (!validInput);
+        
+        return publication;
+    }
+    
+    string getValidSearchId() {
+        string id;
+        bool validInput = false;
+        
+        do {
+            cout << "Enter Book ID to search: ";
+            getline(cin, id);
+            id = trimString(id);
+            
+            if (id.empty()) {
+                cout << "ID cannot be empty. Please try again.\n";
+                continue;
+            }
+            
+            // Check if ID contains only alphanumeric characters
+            bool isAlphanumeric = true;
+            for (char c : id) {
+                if (!isalnum(static_cast<unsigned char>(c))) {
+                    isAlphanumeric = false;
+                    break;
+                }
+            }
+            
+            if (!isAlphanumeric) {
+                cout << "Invalid ID! ID must contain only alphanumeric characters (no spaces or special characters).\n";
+                continue;
+            }
+            
+            validInput = true;
+        } while (!validInput);
+        
+        return id;
+    }
+    
+    StringArray getMultipleAuthors() {
+        StringArray authors;
+        int authorCount = 0;
+        bool validCount = false;
+        
+        do {
+            string input = getValidInput("Enter the number of authors: ");
+            
+            bool isNumber = true;
+            for (char c : input) {
+                if (!isdigit(static_cast<unsigned char>(c))) {
+                    isNumber = false;
+                    break;
+                }
+            }
+            
+            if (!isNumber) {
+                cout << "Invalid input! Please enter a valid number.\n";
+                continue;
+            }
+            
+            authorCount = stoi(input);
+            if (authorCount <= 0) {
+                cout << "Number of authors must be positive. Please try again.\n";
+                continue;
+            }
+            
+            validCount = true;
+        } while (!validCount);
+        
+        authors.reserve(static_cast<size_t>(authorCount));
+        for (int i = 0; i < authorCount; ++i) {
+            authors.push_back(getValidInput("Enter Author " + to_string(i + 1) + ": "));
+        }
+        
+        return authors;
+    }
+    
+    int findBookIndexById(string_view id) const {
+        return idIndex.find(id);
+    }
+
+    // Index every book in the store, dropping any whose ID repeats an earlier one
+    void indexAllBooks() {
+        idIndex.clear();
+        idIndex.reserve(books.length());
+        categoryIndex.clear();
+        isbnIndex.clear();
+        isbnIndex.reserve(books.length());
+        textIndex.clear();
+        textIndexed = false;
+        addedOrder.clear();
+        titleOrder.clear();
+        idOrder.clear();
+        yearOrder.clear();
+        editionOrder.clear();
+        for (size_t i = 0; i < books.slotCount(); ++i) {
+            if (!books.isLive(i)) {
+                continue;
+            }
+            if (!idIndex.insert(static_cast<int>(i))) {
+                cout << "Skipping duplicate book ID " << books[i].getId() << " in catalog file.\n";
+                books.remove(i);
+                continue;
+            }
+            categoryIndex.add(static_cast<int>(i), books[i].getCategoryHandle());
+            isbnIndex.add(static_cast<int>(i));
+        }
+    }
+
+    // Load the last snapshot and replay the journal written since then
+    void loadCatalog() {
+        string error;
+        CatalogFile::LoadResult result = CatalogFile::load(catalogPath, books, error);
+        if (result == CatalogFile::CORRUPT && replica) {
+            books.clear();
+        } else if (result == CatalogFile::CORRUPT) {
+            string badPath = catalogPath + ".bad";
+            cout << "Could not load " << catalogPath << " (" << error << "). "
+                 << "It was moved to " << badPath << " and the catalog starts empty.\n";
+            books.clear();
+            remove(badPath.c_str());
+            rename(catalogPath.c_str(), badPath.c_str());
+        }
+        indexAllBooks();
+
+        bool opened = journal.open([this](Journal::Operation operation, const string& id, Book& book) {
+            applyJournalRecord(operation, id, book);
+        }, error, replica);
+        if (!opened && !replica) {
+            string journalPath = catalogPath + ".journal";
+            string badPath = journalPath + ".bad";
+            cout << "Could not replay " << journalPath << " (" << error << "). "
+                 << "It was moved to " << badPath << ".\n";
+            remove(badPath.c_str());
+            rename(journalPath.c_str(), badPath.c_str());
+            if (!journal.reset(error)) {
+                cout << "Warning: changes will not be saved (" << error << ").\n";
+            }
+        }
+    }
+
+    void applyJournalRecord(Journal::Operation operation, const string& id, Book& book) {
+        int slot = findBookIndexById(id);
+        switch (operation) {
+            case Journal::ADD_BOOK:
+                if (slot == -1) {
+                    insertBook(book);
+                } else {
+                    replaceBook(slot, book);
+                }
+                break;
+            case Journal::EDIT_BOOK:
+                if (slot != -1) {
+                    replaceBook(slot, book);
+                }
+                break;
+            case Journal::DELETE_BOOK:
+                if (slot != -1) {
+                    removeBook(slot);
+                }
+                break;
+        }
+    }
+
+    // Make the journaled changes durable; returns false if they may be lost
+    bool commitChanges() {
+        string error;
+        if (!journal.commit(error)) {
+            cout << "Warning: could not save changes (" << error << ").\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Fold the journal into a fresh snapshot; returns false if it failed
+    bool checkpoint() {
+        string error;
+        if (replica) {
+            return true;
+        }
+        if (abandoned || !commitChanges()) {
+            return false;
+        }
+        if (!CatalogFile::save(catalogPath, books, error) || !journal.reset(error)) {
+            cout << "Warning: could not save catalog (" << error << ").\n";
+            return false;
+        }
+        return true;
+    }
+
+    void checkpointIfNeeded() {
+        if (journal.length() >= CHECKPOINT_RECORDS) {
+            checkpoint();
+        }
+    }
+
+    // Store and index a new book, returning its slot
+    int insertBook(const Book& book) {
+        books.push_back(book);
+        size_t index = books.slotCount() - 1;
+        int slot = static_cast<int>(index);
+        idIndex.insert(slot);
+        categoryIndex.add(slot, books[index].getCategoryHandle());
+        isbnIndex.add(slot);
+        addedOrder.insert(slot);
+        titleOrder.insert(slot);
+        idOrder.insert(slot);
+        yearOrder.insert(slot);
+        editionOrder.insert(slot);
+        if (textIndexed) {
+            textIndex.add(slot, books[index]);
+        }
+        return slot;
+    }
+
+    // Replace the book in a slot with an edited copy that keeps the same ID
+    void replaceBook(int slot, const Book& book) {
+        size_t index = static_cast<size_t>(slot);
+        const Book& current = books[index];
+        if (book.getCategoryHandle() != current.getCategoryHandle()) {
+            categoryIndex.remove(slot, current.getCategoryHandle());
+            categoryIndex.add(slot, book.getCategoryHandle());
+        }
+        bool isbnChanged = canonicalIsbn(book.getValidIsbn()) != canonicalIsbn(current.getValidIsbn());
+        if (isbnChanged) {
+            isbnIndex.remove(slot);
+        }
+        bool wordsChanged = textIndexed && !sameWords(book, current);
+        if (wordsChanged) {
+            textIndex.remove(slot, current);
+        }
+        bool titleMoves = BookTitleOrder::compare(book, current) != 0;
+        bool yearMoves = BookYearOrder::compare(book, current) != 0;
+        bool editionMoves = BookEditionOrder::compare(book, current) != 0;
+        if (titleMoves) {
+            titleOrder.erase(slot);
+        }
+        if (yearMoves) {
+            yearOrder.erase(slot);
+        }
+        if (editionMoves) {
+            editionOrder.erase(slot);
+        }
+        books.replace(index, book);
+        if (isbnChanged) {
+            isbnIndex.add(slot);
+        }
+        if (wordsChanged) {
+            textIndex.add(slot, books[index]);
+        }
+        if (titleMoves) {
+            titleOrder.insert(slot);
+        }
+        if (yearMoves) {
+            yearOrder.insert(slot);
+        }
+        if (editionMoves) {
+            editionOrder.insert(slot);
+        }
+    }
+
+    // Whether two books have the same title and authors
+    static bool sameWords(const Book& a, const Book& b) {
+        Book::AuthorList aAuthors = a.getAuthors();
+        Book::AuthorList bAuthors = b.getAuthors();
+        if (a.getTitle() != b.getTitle() || aAuthors.length() != bAuthors.length()) {
+            return false;
+        }
+        for (size_t i = 0; i < aAuthors.length(); ++i) {
+            if (aAuthors.handle(i) != bAuthors.handle(i)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Books whose title and authors match every word of the query, best
+    // matches first. The word index is prepared on the first search.
+    DynamicArray<TextMatch> findBooksByWords(const string& query, TextIndex::Mode mode) {
+        prepareWordSearch();
+        return textIndex.search(query, mode);
+    }
+
+    // Slots of every book with this ISBN, in the order they were added
+    DynamicArray<int> findBooksByIsbn(const string& isbn) const {
+        DynamicArray<int> matches;
+        for (int slot = isbnIndex.first(isbn); slot != -1; slot = isbnIndex.following(slot)) {
+            matches.push_back(slot);
+        }
+        sort(matches.begin(), matches.end());
+        return matches;
+    }
+
+    // Warn about a bad check digit or an ISBN other books already use, and
+    // ask whether to keep a duplicate. exceptSlot is the book being edited.
+    bool confirmIsbn(const string& isbn, int exceptSlot) {
+        if (!isbnCheckDigitValid(isbn)) {
+            cout << "Note: the check digit of ISBN " << isbn << " does not match; please double-check it.\n";
+        }
+        DynamicArray<int> matches = findBooksByIsbn(isbn);
+        bool duplicate = false;
+        for (int slot : matches) {
+            if (slot == exceptSlot) {
+                continue;
+            }
+            if (!duplicate) {
+                cout << "This ISBN is already used by book ID";
+                duplicate = true;
+            }
+            cout << " " << books[static_cast<size_t>(slot)].getId();
+        }
+        if (!duplicate) {
+            return true;
+        }
+        cout << ".\n";
+        return getYesNoInput("Use this ISBN anyway? (yes/no): ");
+    }
+
+    // Unindex a book and leave a tombstone in its slot
+    void removeBook(int slot) {
+        size_t index = static_cast<size_t>(slot);
+        idIndex.erase(slot);
+        categoryIndex.remove(slot, books[index].getCategoryHandle());
+        isbnIndex.remove(slot);
+        if (textIndexed) {
+            textIndex.remove(slot, books[index]);
+        }
+        addedOrder.erase(slot);
+        titleOrder.erase(slot);
+        idOrder.erase(slot);
+        yearOrder.erase(slot);
+        editionOrder.erase(slot);
+        books.remove(index);
+    }
+
+    // Squeeze out tombstones once they outnumber the live books. Called
+    // between operations, so deletes themselves stay O(1).
+    void compactIfNeeded() {
+        if (books.removedCount() < MIN_COMPACT_SLOTS || books.removedCount() < books.length()) {
+            return;
+        }
+        DynamicArray<int> newSlots;
+        newSlots.resize(books.slotCount());
+        for (size_t i = 0; i < books.slotCount(); ++i) {
+            newSlots[i] = static_cast<int>(i);
+        }
+        books.compact([this, &newSlots](int from, int to) {
+            idIndex.relocate(from, to);
+            categoryIndex.relocate(from, to, books[static_cast<size_t>(to)].getCategoryHandle());
+            isbnIndex.relocate(from, to);
+            newSlots[static_cast<size_t>(from)] = to;
+        });
+        // Compaction keeps books in order, so the ordered indexes only need
+        // their slot numbers updated
+        addedOrder.renumber(newSlots);
+        titleOrder.renumber(newSlots);
+        idOrder.renumber(newSlots);
+        yearOrder.renumber(newSlots);
+        editionOrder.renumber(newSlots);
+        // Word postings are spread over many lists, so rebuild them on the
+        // next word search instead of relocating each one
+        textIndex.clear();
+        textIndexed = false;
+    }
+    
+    void pressAnyContinue() {
+        cout << "Press Enter to Continue...";
+        cin.get();
+    }
+
+    void displayTableHeader() {
+        table.writeHeader();
+        screen.flush();
+    }
+
+    void displayBookDetails(const Book& book) {
+        table.writeRow(book);
+        screen.flush();
+    }
+
+    // Called before each row of a listing; after every full page it asks
+    // whether to go on. Returns false when the user stops the listing.
+    bool continueListing(size_t shown, size_t total, bool& showAll) {
+        if (showAll || shown == 0 || shown % PAGE_SIZE != 0) {
+            return true;
+        }
+        screen.flush();
+        string input;
+        cout << "-- " << shown;
+        if (total > 0) {
+            cout << " of " << total;
+        }
+        cout << " shown. Press Enter for more, 'a' for all, or 'q' to stop: ";
+        getline(cin, input);
+        input = trimString(input);
+        if (caseInsensitiveCompare(input, "q")) {
+            return false;
+        }
+        if (caseInsensitiveCompare(input, "a")) {
+            showAll = true;
+        }
+        return true;
+    }
+
+    // Page through books in the order of an ordered index, optionally
+    // limited to a range typed as "from-to" (or a single value). A bound
+    // takes in every key it begins, so "A-C" runs through titles starting
+    // with C. Each page is found by position, so jumping ahead costs no
+    // more than turning one page.
+    template <typename Order>
+    void browseBooks(OrderedIndex<Order>& index, const string& name, const string& example) {
+        if (!index.isBuilt()) {
+            index.build();
+        }
+
+        string range;
+        string from;
+        string to;
+        bool validRange = example.empty();
+        while (!validRange) {
+            cout << "Enter a range such as " << example << ", or press Enter for all books: ";
+            getline(cin, range);
+            range = trimString(range);
+            if (range.empty()) {
+                validRange = true;
+                continue;
+            }
+            size_t dash = range.find('-');
+            from = trimString(range.substr(0, dash));
+            to = dash == string::npos ? from : trimString(range.substr(dash + 1));
+            if (from.empty() || to.empty() || !Order::validBound(from) || !Order::validBound(to)) {
+                cout << "Invalid range! Please enter it like " << example << ".\n";
+                continue;
+            }
+            validRange = true;
+        }
+
+        size_t first = 0;
+        size_t total = index.length();
+        if (!range.empty()) {
+            size_t upper = index.rank(to, true);
+            first = index.rank(from, false);
+            total = upper > first ? upper - first : 0;
+        }
+
+        cout << "\n--- " << name;
+        if (!range.empty()) {
+            cout << " (" << from << " to " << to << ")";
+        }
+        cout << ": " << total << " book(s) ---\n";
+
+        size_t pages = (total + PAGE_SIZE - 1) / PAGE_SIZE;
+        size_t page = 0;
+        while (page < pages) {
+            size_t start = page * PAGE_SIZE;
+            size_t end = min(total, start + PAGE_SIZE);
+            table.writeHeader();
+            typename OrderedIndex<Order>::Cursor cursor = index.at(first + start);
+            for (size_t i = start; i < end && cursor.valid(); ++i, cursor.advance()) {
+                table.writeRow(books[static_cast<size_t>(cursor.slot())]);
+            }
+            screen.flush();
+            if (pages == 1) {
+                break;
+            }
+            page = askPage(page, pages);
+        }
+        pressAnyContinue();
+    }
+
+    // Ask where to go after showing a page; returns the next page to show,
+    // or pages to stop
+    size_t askPage(size_t page, size_t pages) {
+        while (true) {
+            string input;
+            cout << "-- Page " << page + 1 << " of " << pages
+                 << ". Press Enter for the next page, type a page number to jump to it, or 'q' to stop: ";
+            getline(cin, input);
+            input = trimString(input);
+            if (input.empty()) {
+                return page + 1;
+            }
+            if (caseInsensitiveCompare(input, "q") || !cin) {
+                return pages;
+            }
+            size_t number = 0;
+            bool digits = input.size() <= 18;
+            for (char c : input) {
+                digits = digits && isdigit(static_cast<unsigned char>(c));
+                number = number * 10 + static_cast<size_t>(c - '0');
+            }
+            if (digits && number >= 1 && number <= pages) {
+                return number - 1;
+            }
+            cout << "Invalid page! Please enter a number between 1 and " << pages << ".\n";
+        }
+    }
+
+    // Fill a page starting at a cursor position in an ordered index
+    template <typename Order>
+    void fillPage(const OrderedIndex<Order>& index, typename OrderedIndex<Order>::Cursor cursor,
+                  size_t first, size_t pageSize, BookPage& page) const {
+        page.slots.clear();
+        page.first = first;
+        page.total = index.length();
+        page.next.clear();
+        for (; cursor.valid() && page.slots.length() < pageSize; cursor.advance()) {
+            page.slots.push_back(cursor.slot());
+        }
+        if (cursor.valid() && !page.slots.empty()) {
+            size_t last = static_cast<size_t>(page.slots[page.slots.length() - 1]);
+            page.next = to_string(books.sequence(last)) + ":";
+            page.next.append(Order::keyOf(books[last]));
+        }
+    }
+
+    // Call visit(index) with the ordered index for a listing order, built
+    template <typename Visit>
+    void withOrder(ListOrder order, Visit visit) {
+        switch (order) {
+            case BY_TITLE:
+                visit(titleOrder);
+                break;
+            case BY_ID:
+                visit(idOrder);
+                break;
+            case BY_YEAR:
+                visit(yearOrder);
+                break;
+            case BY_EDITION:
+                visit(editionOrder);
+                break;
+            case BY_ADDED:
+                visit(addedOrder);
+                break;
+        }
+    }
+
+    // Build a book from a batch record; returns an error message, or "" on success
+    static string parseRecord(const string& text, Book& book) {
+        DynamicArray<string> fields;
+        splitEscaped(text, '|', fields);
+        if (fields.length() != RECORD_FIELDS) {
+            return "expected " + to_string(RECORD_FIELDS) + " fields separated by '|' but found " +
+                   to_string(fields.length());
+        }
+        DynamicArray<string> names;
+        splitEscaped(fields[3], ';', names);
+        StringArray authors;
+        authors.reserve(names.length());
+        for (const string& name : names) {
+            authors.push_back(unescapeField(name));
+        }
+        string edition = unescapeField(fields[4]);
+        string category = unescapeField(fields[6]);
+        string error = checkInternedFields(edition, category, authors);
+        if (!error.empty()) {
+            return error;
+        }
+        book = Book(unescapeField(fields[0]), unescapeField(fields[1]), unescapeField(fields[2]), authors, edition,
+                    unescapeField(fields[5]), category);
+        return validateBook(book);
+    }
+
+    // LIST order size [page | cursor]
+    string runListCommand(const string& argument, string& out) {
+        size_t space = argument.find(' ');
+        string name = toLowercase(argument.substr(0, space));
+        string rest = space == string::npos ? "" : trimString(argument.substr(space + 1));
+        space = rest.find(' ');
+        string sizeText = rest.substr(0, space);
+        string position = space == string::npos ? "" : trimString(rest.substr(space + 1));
+
+        ListOrder order;
+        if (name == "added") {
+            order = BY_ADDED;
+        } else if (name == "title") {
+            order = BY_TITLE;
+        } else if (name == "id") {
+            order = BY_ID;
+        } else if (name == "year") {
+            order = BY_YEAR;
+        } else if (name == "edition") {
+            order = BY_EDITION;
+        } else {
+            return "usage: LIST added|title|id|year|edition size [page | cursor]";
+        }
+        size_t pageSize = 0;
+        for (char c : sizeText) {
+            if (!isdigit(static_cast<unsigned char>(c)) || pageSize > MAX_BATCH_PAGE) {
+                pageSize = 0;
+                break;
+            }
+            pageSize = pageSize * 10 + static_cast<size_t>(c - '0');
+        }
+        if (pageSize == 0 || pageSize > MAX_BATCH_PAGE) {
+            return "page size must be between 1 and " + to_string(MAX_BATCH_PAGE);
+        }
+
+        BookPage page;
+        if (position.find(':') != string::npos) {
+            if (!listBooksAfter(order, unescapeField(position), pageSize, page)) {
+                return "malformed cursor '" + position + "'";
+            }
+        } else {
+            size_t number = 0;
+            for (char c : position) {
+                if (!isdigit(static_cast<unsigned char>(c)) || number > books.slotCount()) {
+                    return "page must be a number or a cursor";
+                }
+                number = number * 10 + static_cast<size_t>(c - '0');
+            }
+            page = listBooks(order, number, pageSize);
+        }
+        out += "OK " + to_string(page.slots.length()) + " " + to_string(page.first) + " " + to_string(page.total) + " ";
+        // The cursor holds a sort key, escaped like a record field
+        if (page.next.empty()) {
+            out += '-';
+        } else {
+            appendEscaped(out, page.next);
+        }
+        out += '\n';
+        for (int slot : page.slots) {
+            appendRecord(out, books[static_cast<size_t>(slot)]);
+        }
+        return "";
+    }
+
+    // Read "from-to [category]" or "year [category]" for FILTER and COUNT
+    static string parseFilter(const string& argument, int& fromYear, int& toYear, string& category) {
+        size_t space = argument.find(' ');
+        string years = argument.substr(0, space);
+        category = space == string::npos ? "" : trimString(argument.substr(space + 1));
+        size_t dash = years.find('-');
+        string from = years.substr(0, dash);
+        string to = dash == string::npos ? from : years.substr(dash + 1);
+        if (checkPublicationYear(from) != YEAR_OK || checkPublicationYear(to) != YEAR_OK) {
+            return "years must be given as YYYY or YYYY-YYYY";
+        }
+        fromYear = publicationYear(from);
+        toYear = publicationYear(to);
+        if (!category.empty() && !normalizeCategory(category, category)) {
+            return "unknown category '" + category + "'";
+        }
+        return "";
+    }
+
+    // Make a group of batch changes durable, then release their results.
+    // changes holds where each change's result starts.
+    bool finishBatchGroup(string& results, DynamicArray<size_t>& changes, bool& changed) {
+        bool saved = settleChanges(changed);
+        if (!saved) {
+            abandonChanges();
+            markUnsaved(results, changes);
+        }
+        changed = false;
+        changes.clear();
+        screen.write(results);
+        screen.flush();
+        results.clear();
+        return saved;
+    }
+
+    bool getYesNoInput(const string& prompt) {
+        string input;
+        bool validInput = false;
+        bool result = false;
+        
+        do {
+            input = getValidInput(prompt);
+            
+            if (caseInsensitiveCompare(input, "yes") || 
+                caseInsensitiveCompare(input, "y")) {
+                result = true;
+                validInput = true;
+            } else if (caseInsensitiveCompare(input, "no") || 
+                       caseInsensitiveCompare(input, "n")) {
+                result = false;
+                validInput = true;
+            } else {
+                cout << "Invalid input. Please enter 'yes' or 'no'.\n";
+            }
+        } while (!validInput);
+        
+        return result;
+    }
+
+public:
+    // A replica loads the same catalog but never writes its files, so it can
+    // be kept beside the copy that owns them and given the same changes
+    explicit LibraryManagementSystem(const string& path = "library.dat", bool readOnly = false)
+        : idIndex(books), isbnIndex(books), addedOrder(books), titleOrder(books), idOrder(books), yearOrder(books),
+          editionOrder(books), textIndexed(false), catalogPath(path), replica(readOnly),
+          abandoned(false), journal(path + ".journal"), screen(stdout), table(screen) {
+        books.reserve(INITIAL_BOOKS);
+        idIndex.reserve(INITIAL_BOOKS);
+        loadCatalog();
+    }
+
+    // Page number pageNumber (from 0) of the catalog in the given order, in
+    // O(log n + pageSize) however far into the catalog it is
+    BookPage listBooks(ListOrder order, size_t pageNumber, size_t pageSize) {
+        BookPage page;
+        withOrder(order, [this, &page, pageNumber, pageSize](auto& index) {
+            if (!index.isBuilt()) {
+                index.build();
+            }
+            size_t first = pageNumber * pageSize;
+            fillPage(index, index.at(first), first, pageSize, page);
+        });
+        return page;
+    }
+
+    // The page following a cursor from an earlier page, in O(log n + pageSize).
+    // Returns false if the cursor is malformed.
+    bool listBooksAfter(ListOrder order, const string& cursor, size_t pageSize, BookPage& page) {
+        size_t colon = cursor.find(':');
+        if (colon == string::npos || colon == 0 || colon > 20) {
+            return false;
+        }
+        uint64_t sequence = 0;
+        for (size_t i = 0; i < colon; ++i) {
+            if (!isdigit(static_cast<unsigned char>(cursor[i]))) {
+                return false;
+            }
+            sequence = sequence * 10 + static_cast<uint64_t>(cursor[i] - '0');
+        }
+        string key = cursor.substr(colon + 1);
+        withOrder(order, [this, &page, &key, sequence, pageSize](auto& index) {
+            if (!index.isBuilt()) {
+                index.build();
+            }
+            fillPage(index, index.after(key, sequence), index.rankAfter(key, sequence), pageSize, page);
+        });
+        return true;
+    }
+
+    // Books published from fromYear to toYear, and in category or one of
+    // its subcategories unless it is empty, in the order they were added.
+    // Only the store's year and category columns are scanned, so this runs
+    // at memory speed.
+    DynamicArray<int> filterBooks(int fromYear, int toYear, const string& category) const {
+        DynamicArray<int> slots;
+        int code = category.empty() ? -1 : categoryCode(category);
+        if (category.empty() || code >= 0) {
+            books.collectMatching(fromYear, toYear, code, code < 0 ? -1 : bookCategories.lastCode(code), slots);
+        }
+        return slots;
+    }
+
+    // How many books filterBooks() would return
+    size_t countBooks(int fromYear, int toYear, const string& category) const {
+        int code = category.empty() ? -1 : categoryCode(category);
+        if (!category.empty() && code < 0) {
+            return 0;
+        }
+        return books.countMatching(fromYear, toYear, code, code < 0 ? -1 : bookCategories.lastCode(code));
+    }
+
+    void addBook() {
+        bool continuedAdding = true;
+        
+        while (continuedAdding) {
+            string category = getValidCategory();
+            string id = getValidId();
+            string isbn = getValidIsbn(); 
+            while (!confirmIsbn(isbn, -1)) {
+                isbn = getValidIsbn();
+            }
+            string title = getValidInput("Enter Title: ");
+            StringArray authors = getMultipleAuthors();
+            string edition = getValidInput("Enter Edition: ");
+            string publication = getValidPublication();
+    
+            int slot = insertBook(Book(id, isbn, title, authors, edition, publication, category));
+            journal.logAdd(books[static_cast<size_t>(slot)]);
+            if (commitChanges()) {
+                cout << "Book added successfully!\n";
+            }
+    
+            continuedAdding = getYesNoInput("Would you like to add another book? (yes/no): ");
+        }
+    }
+
+    void editBook() {
+        bool bookFound = false;
+        
+        while (!bookFound) {
+            string id = getValidSearchId();
+            int index = findBookIndexById(id);
+            
+            if (index != -1) {
+                Book book = books[static_cast<size_t>(index)];
+                
+                // Update ISBN with proper validation for digits and 'x' only
+                string newIsbn = getValidInput("Enter new ISBN (or press Enter to skip): ", true);
+                if (!newIsbn.empty()) {
+                    // Check if ISBN contains only digits and 'x'
+                    IsbnCheck check = checkIsbn(newIsbn);
+                    if (check == ISBN_BAD_CHARACTERS) {
+                        cout << "Invalid ISBN! ISBN must contain only digits and 'x'. Skipping ISBN update.\n";
+                    } else if (check == ISBN_BAD_LENGTH) {
+                        cout << "Invalid ISBN! ISBN must contain exactly 10 or 13 characters. Skipping ISBN update.\n";
+                    } else if (confirmIsbn(newIsbn, index)) {
+                        book.setIsbn(newIsbn);
+                    } else {
+                        cout << "Skipping ISBN update.\n";
+                    }
+                }
+                
+                string newTitle = getValidInput("Enter new Title (or press Enter to skip): ", true);
+                if (!newTitle.empty()) book.setTitle(newTitle);
+                
+                // Update authors
+                cout << "Update authors? ";
+                if (getYesNoInput("(yes/no): ")) {
+                    book.setAuthors(getMultipleAuthors());
+                }
+                
+                // Update edition as simple string
+                string newEdition = getValidInput("Enter new Edition (or press Enter to skip): ", true);
+                if (!newEdition.empty()) {
+                    book.setEdition(newEdition);
+                }
+                
+                string newPublication = getValidInput("Enter new Publication Year (or press Enter to skip): ", true);
+                if (!newPublication.empty()) {
+                    // Check if the input is a 4-digit year
+                    YearCheck check = checkPublicationYear(newPublication);
+                    if (check == YEAR_OK) {
+                        book.setPublication(newPublication);
+                    } else if (check == YEAR_OUT_OF_RANGE) {
+                        cout << "Invalid year! Year must be between 1000 and 2100. Skipping Publication update.\n";
+                    } else {
+                        cout << "Invalid publication year! Publication must be a 4-digit year. Skipping Publication update.\n";
+                    }
+                }
+                
+                cout << "Update category? ";
+                if (getYesNoInput("(yes/no): ")) {
+                    book.setCategory(getValidCategory());
+                } else {
+                    cout << "Book category is not updated." << endl;
+                }
+                
+                journal.logEdit(book);
+                replaceBook(index, book);
+                if (commitChanges()) {
+                    cout << "Book edited successfully!\n";
+                }
+                bookFound = true;
+            } else {
+                cout << "Book not found!\n";
+                if (!getYesNoInput("Do you want to try again? (yes/no): ")) {
+                    bookFound = true;
+                }
+            }
+        }
+    }
+    
+    void searchBook() {
+        cout << "Search by: 1 - ID, 2 - ISBN, 3 - Title/author words, "
+             << "4 - Beginnings of words, 5 - Similar spelling\n";
+        string mode;
+        bool validMode = false;
+        do {
+            mode = getValidInput("Enter search type (1-5): ");
+            if (mode.size() == 1 && mode[0] >= '1' && mode[0] <= '5') {
+                validMode = true;
+            } else {
+                cout << "Invalid choice! Please enter a number between 1 and 5.\n";
+            }
+        } while (!validMode);
+
+        if (mode == "1") {
+            searchBookById();
+        } else if (mode == "2") {
+            searchBookByIsbn();
+        } else if (mode == "3") {
+            searchBookByWords(TextIndex::EXACT);
+        } else if (mode == "4") {
+            searchBookByWords(TextIndex::PREFIX);
+        } else {
+            searchBookByWords(TextIndex::SIMILAR);
+        }
+    }
+
+    void searchBookById() {
+        bool bookFound = false;
+        
+        while (!bookFound) {
+            string id = getValidSearchId();
+            int index = findBookIndexById(id);
+            
+            if (index != -1) {
+                cout << "\n--- Book Details ---\n";
+                displayTableHeader();
+                displayBookDetails(books[static_cast<size_t>(index)]);
+                bookFound = true;
+            } else {
+                cout << "Book not found!\n";
+                if (!getYesNoInput("Do you want to try again? (yes/no): ")) {
+                    bookFound = true;
+                }
+            }
+        }
+    }
+
+    // Lists every copy whose ISBN matches in either ISBN-10 or ISBN-13 form
+    void searchBookByIsbn() {
+        bool bookFound = false;
+        
+        while (!bookFound) {
+            string isbn = getValidIsbn();
+            DynamicArray<int> matches = findBooksByIsbn(isbn);
+            
+            if (!matches.empty()) {
+                cout << "\n--- Books with ISBN " << isbn << " ---\n";
+                table.writeHeader();
+                for (int slot : matches) {
+                    table.writeRow(books[static_cast<size_t>(slot)]);
+                }
+                screen.flush();
+                bookFound = true;
+            } else {
+                cout << "No book with this ISBN found!\n";
+                if (!getYesNoInput("Do you want to try again? (yes/no): ")) {
+                    bookFound = true;
+                }
+            }
+        }
+    }
+    
+    // Lists books matching all the given words, best matches first. Words
+    // match exactly, as the start of a longer word ("tolk" finds Tolkien),
+    // or with up to two typos, depending on mode.
+    void searchBookByWords(TextIndex::Mode mode) {
+        bool bookFound = false;
+        
+        while (!bookFound) {
+            string query = getValidInput("Enter words from the title or author names: ");
+            DynamicArray<TextMatch> matches = findBooksByWords(query, mode);
+            
+            if (!matches.empty()) {
+                cout << "\n--- " << matches.length() << " book(s) matching \"" << query << "\" ---\n";
+                table.writeHeader();
+                size_t shown = 0;
+                bool showAll = false;
+                for (const TextMatch& match : matches) {
+                    if (!continueListing(shown, matches.length(), showAll)) {
+                        break;
+                    }
+                    table.writeRow(books[static_cast<size_t>(match.slot)]);
+                    ++shown;
+                }
+                screen.flush();
+                bookFound = true;
+            } else {
+                cout << "No book matches all of these words!\n";
+                if (!getYesNoInput("Do you want to try again? (yes/no): ")) {
+                    bookFound = true;
+                }
+            }
+        }
+    }
+    
+    void deleteBook() {
+        bool bookFound = false;
+        
+        while (!bookFound) {
+            string id = getValidSearchId();
+            int index = findBookIndexById(id);
+            
+            if (index != -1) {
+                cout << "\n--- Book Details ---\n";
+                displayTableHeader();
+                displayBookDetails(books[static_cast<size_t>(index)]);
+                
+                if (getYesNoInput("Do you want to delete this book? (yes/no): ")) {
+                    journal.logDelete(books[static_cast<size_t>(index)].getId());
+                    removeBook(index);
+                    if (commitChanges()) {
+                        cout << "Book deleted successfully!\n";
+                    }
+                    bookFound = true;
+                } else {
+                    bookFound = true;
+                }
+            } else {
+                cout << "Book not found!\n";
+                if (!getYesNoInput("Do you want to try again? (yes/no): ")) {
+                    bookFound = true;
+                }
+            }
+        }
+    }
+
+    void viewBooksByCategory() {
+        string category = getValidCategory();
+
+        cout << "\n--- Books in " << category << " Category ---\n";
+        table.writeHeader();
+
+        size_t total = categoryIndex.count(category);
+        size_t shown = 0;
+        bool showAll = false;
+        categoryIndex.forEach(category, [&](int slot) {
+            if (!continueListing(shown, total, showAll)) {
+                return false;
+            }
+            table.writeRow(books[static_cast<size_t>(slot)]);
+            ++shown;
+            return true;
+        });
+        screen.flush();
+
+        if (total == 0) {
+            cout << "No books found in this category.\n";
+        }
+        pressAnyContinue();
+    }
+
+    void viewAllBooks() {
+        if (books.empty()) {
+            cout << "No books in the library.\n";
+            pressAnyContinue();
+            return;
+        }
+
+        cout << "Sort by: 1 - Order added, 2 - Title, 3 - ID, 4 - Publication year, 5 - Edition\n";
+        string order;
+        bool validOrder = false;
+        do {
+            order = getValidInput("Enter sort order (1-5): ");
+            if (order.size() == 1 && order[0] >= '1' && order[0] <= '5') {
+                validOrder = true;
+            } else {
+                cout << "Invalid choice! Please enter a number between 1 and 5.\n";
+            }
+        } while (!validOrder);
+
+        if (order == "1") {
+            browseBooks(addedOrder, "All Books", "");
+        } else if (order == "2") {
+            browseBooks(titleOrder, "Books by Title", "A-C");
+        } else if (order == "3") {
+            browseBooks(idOrder, "Books by ID", "B100-B199");
+        } else if (order == "4") {
+            browseBooks(yearOrder, "Books by Publication year", "1990-2005");
+        } else {
+            browseBooks(editionOrder, "Books by Edition", "1st-3rd");
+        }
+    }
+
+    void importBooks() {
+        string path = getValidInput("Enter the path of the CSV or TSV file to import: ");
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        BookImporter importer;
+        if (!importer.parse(path)) {
+            cout << "Could not open " << path << ".\n";
+            pressAnyContinue();
+            return;
+        }
+
+        // Insert the parsed books in file order; the chunks already hold
+        // their own rejected rows
+        DynamicArray<ImportError> errors;
+        DynamicArray<int> added;
+        books.reserve(books.slotCount() + importer.validRows());
+        idIndex.reserve(books.length() + importer.validRows());
+        for (size_t c = 0; c < importer.length(); ++c) {
+            BookImporter::Chunk& chunk = importer[c];
+            for (ImportError& error : chunk.errors) {
+                errors.push_back(std::move(error));
+            }
+            for (size_t i = 0; i < chunk.books.slotCount(); ++i) {
+                if (!isIdUnique(chunk.books[i].getId())) {
+                    errors.push_back(ImportError{chunk.lines[i], "duplicate ID '" + string(chunk.books[i].getId()) + "'"});
+                    continue;
+                }
+                added.push_back(insertBook(chunk.books[i]));
+            }
+        }
+        // One snapshot covers the whole batch instead of a journal record per
+        // book; if it cannot be written, journal the books after all
+        bool saved = true;
+        if (!added.empty() && !checkpoint()) {
+            for (int slot : added) {
+                journal.logAdd(books[static_cast<size_t>(slot)]);
+            }
+            saved = commitChanges();
+        }
+        sort(errors.begin(), errors.end());
+
+        long long elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+        cout << "Imported " << added.length() << " books from " << path << " in " << elapsed << " ms.\n";
+        if (!saved) {
+            cout << "Warning: the imported books could not be saved.\n";
+        }
+        if (!errors.empty()) {
+            size_t shown = errors.length() < MAX_SHOWN_IMPORT_ERRORS ? errors.length() : MAX_SHOWN_IMPORT_ERRORS;
+            cout << errors.length() << " rows were rejected:\n";
+            for (size_t i = 0; i < shown; ++i) {
+                cout << "  Line " << errors[i].line << ": " << errors[i].message << "\n";
+            }
+            if (errors.length() > shown) {
+                string reportPath = path + ".errors.txt";
+                ofstream report(reportPath);
+                for (const ImportError& error : errors) {
+                    report << "Line " << error.line << ": " << error.message << "\n";
+                }
+                cout << "  ... see " << reportPath << " for all " << errors.length() << " rejected rows.\n";
+            }
+        }
+        pressAnyContinue();
+    }
+
+    void exportBooks() {
+        cout << "Export format? ";
+        string format;
+        bool validFormat = false;
+        do {
+            format = getValidInput("(csv/jsonl): ");
+            if (caseInsensitiveCompare(format, "csv") || caseInsensitiveCompare(format, "jsonl")) {
+                validFormat = true;
+            } else {
+                cout << "Invalid format. Please enter 'csv' or 'jsonl'.\n";
+            }
+        } while (!validFormat);
+
+        string category;
+        if (!getYesNoInput("Export all books? (yes/no): ")) {
+            category = getValidCategory();
+        }
+        string path = getValidInput("Enter output file path (or press Enter to print to the screen): ", true);
+
+        FILE* file = stdout;
+        if (!path.empty()) {
+            file = fopen(path.c_str(), "wb");
+            if (file == nullptr) {
+                cout << "Could not open " << path << " for writing.\n";
+                pressAnyContinue();
+                return;
+            }
+        }
+        cout.flush();
+
+        size_t exported = 0;
+        bool ok;
+        {
+            OutputBuffer out(file);
+            BookExporter exporter(out, caseInsensitiveCompare(format, "csv") ? BookExporter::CSV : BookExporter::JSON_LINES);
+            exporter.writeHeader();
+            if (category.empty()) {
+                for (size_t i = 0; i < books.slotCount(); ++i) {
+                    if (books.isLive(i)) {
+                        exporter.write(books[i]);
+                        ++exported;
+                    }
+                }
+            } else {
+                categoryIndex.forEach(category, [&](int slot) {
+                    exporter.write(books[static_cast<size_t>(slot)]);
+                    ++exported;
+                    return true;
+                });
+            }
+            ok = out.flush();
+        }
+        if (file != stdout) {
+            ok = fclose(file) == 0 && ok;
+        }
+
+        if (!ok) {
+            cout << "Export failed while writing " << (path.empty() ? "to the screen" : path) << ".\n";
+        } else if (!path.empty()) {
+            cout << "Exported " << exported << " books to " << path << ".\n";
+        }
+        pressAnyContinue();
+    }
+
+    int getMenuChoice() {
+        string input;
+        bool validChoice = false;
+        int choice = 0;
+        
+        do {
+            cout << "\n--- Library Management System ---\n";
+            cout << "1 - Add Book\n";
+            cout << "2 - Edit Book\n";
+            cout << "3 - Search Book\n";
+            cout << "4 - Delete Book\n";
+            cout << "5 - View Books by Category\n";
+            cout << "6 - View All Books\n";
+            cout << "7 - Import Books from File\n";
+            cout << "8 - Export Books to File\n";
+            cout << "9 - Exit\n";
+            cout << "Enter your choice (1-9): ";
+
+            getline(cin, input);
             
-            if (isbn.empty()) {
-                cout << "ISBN cannot be empty. Please try again.\n";
+            // Manual validation 
+            if (input.length() == 1 && input[0] >= '1' && input[0] <= '9') {
+                choice = input[0] - '0';
+                validChoice = true;
+            } else {
+                cout << "Invalid choice! Please enter a single digit between 1 and 9.\n";
+            }
+        } while (!validChoice);
+        
+        return choice;
+    }
+
+    // Run one batch command and append its result to out. changed is set
+    // when the command modified the catalog.
+    bool runCommand(const string& line, string& out, bool& changed) {
+        size_t space = line.find(' ');
+        string verb = toLowercase(line.substr(0, space));
+        string argument = space == string::npos ? "" : trimString(line.substr(space + 1));
+        string error;
+
+        if (verb == "add" || verb == "edit") {
+            Book book;
+            error = parseRecord(argument, book);
+            int slot = error.empty() ? findBookIndexById(book.getId()) : -1;
+            if (error.empty() && verb == "add" && slot != -1) {
+                error = "duplicate ID '" + string(book.getId()) + "'";
+            } else if (error.empty() && verb == "edit" && slot == -1) {
+                error = "no book with ID '" + string(book.getId()) + "'";
+            } else if (error.empty()) {
+                if (verb == "add") {
+                    slot = insertBook(book);
+                    journal.logAdd(books[static_cast<size_t>(slot)]);
+                } else {
+                    journal.logEdit(book);
+                    replaceBook(slot, book);
+                }
+                changed = true;
+                out += "OK\n";
+                return true;
+            }
+        } else if (verb == "del" || verb == "get") {
+            string id = unescapeField(argument);
+            int slot = findBookIndexById(id);
+            if (slot == -1) {
+                error = "no book with ID '" + id + "'";
+            } else if (verb == "del") {
+                journal.logDelete(books[static_cast<size_t>(slot)].getId());
+                removeBook(slot);
+                changed = true;
+                out += "OK\n";
+                return true;
+            } else {
+                out += "OK ";
+                appendRecord(out, books[static_cast<size_t>(slot)]);
+                return true;
+            }
+        } else if (verb == "isbn") {
+            DynamicArray<int> matches = findBooksByIsbn(unescapeField(argument));
+            out += "OK " + to_string(matches.length()) + "\n";
+            for (int slot : matches) {
+                appendRecord(out, books[static_cast<size_t>(slot)]);
+            }
+            return true;
+        } else if (verb == "find" || verb == "prefix" || verb == "similar") {
+            TextIndex::Mode mode = verb == "find" ? TextIndex::EXACT : verb == "prefix" ? TextIndex::PREFIX
+                                                                                        : TextIndex::SIMILAR;
+            DynamicArray<TextMatch> matches = findBooksByWords(argument, mode);
+            out += "OK " + to_string(matches.length()) + "\n";
+            for (const TextMatch& match : matches) {
+                appendRecord(out, books[static_cast<size_t>(match.slot)]);
+            }
+            return true;
+        } else if (verb == "list") {
+            error = runListCommand(argument, out);
+            if (error.empty()) {
+                return true;
+            }
+        } else if (verb == "filter" || (verb == "count" && !argument.empty())) {
+            int fromYear = 0;
+            int toYear = 0;
+            string category;
+            error = parseFilter(argument, fromYear, toYear, category);
+            if (error.empty() && verb == "count") {
+                out += "OK " + to_string(countBooks(fromYear, toYear, category)) + "\n";
+                return true;
+            } else if (error.empty()) {
+                DynamicArray<int> matches = filterBooks(fromYear, toYear, category);
+                out += "OK " + to_string(matches.length()) + "\n";
+                for (int slot : matches) {
+                    appendRecord(out, books[static_cast<size_t>(slot)]);
+                }
+                return true;
+            }
+        } else if (verb == "count") {
+            out += "OK " + to_string(books.length()) + "\n";
+            return true;
+        } else {
+            error = "unknown command '" + verb + "'";
+        }
+
+        out += "ERR " + error + "\n";
+        return false;
+    }
+
+    // Whether a command only reads the catalog. Once prepareSharedReads()
+    // and prepareWordSearch() have run, such commands may run on several
+    // threads at once as long as nothing else does.
+    static bool isReadOnlyCommand(const string& line) {
+        size_t space = line.find(' ');
+        string verb = toLowercase(line.substr(0, space));
+        return verb == "get" || verb == "isbn" || verb == "list" || verb == "count" || verb == "filter"
+               || verb == "find" || verb == "prefix" || verb == "similar";
+    }
+
+    // Whether a command may change the catalog
+    static bool isChangingCommand(const string& line) {
+        size_t space = line.find(' ');
+        string verb = toLowercase(line.substr(0, space));
+        return verb == "add" || verb == "edit" || verb == "del";
+    }
+
+    // Build the indexes that listings would otherwise build on first use
+    void prepareSharedReads() {
+        withOrder(BY_ADDED, [](auto& index) { index.build(); });
+        withOrder(BY_TITLE, [](auto& index) { index.build(); });
+        withOrder(BY_ID, [](auto& index) { index.build(); });
+        withOrder(BY_YEAR, [](auto& index) { index.build(); });
+        withOrder(BY_EDITION, [](auto& index) { index.build(); });
+    }
+
+    // Build the word index if it is not there yet and tidy it, after which
+    // searches leave it alone. Changes keep it up to date until compaction
+    // drops it.
+    void prepareWordSearch() {
+        if (!textIndexed) {
+            for (size_t i = 0; i < books.slotCount(); ++i) {
+                if (books.isLive(i)) {
+                    textIndex.add(static_cast<int>(i), books[i]);
+                }
+            }
+            textIndexed = true;
+        }
+        if (!textIndex.isTidy()) {
+            textIndex.tidy();
+        }
+    }
+
+    // Commit what commands have changed, then compact or checkpoint if it
+    // is time to. Returns false if the changes could not be saved.
+    bool settleChanges(bool changed) {
+        bool saved = !changed || commitChanges();
+        compactIfNeeded();
+        if (saved) {
+            checkpointIfNeeded();
+        }
+        return saved;
+    }
+
+    // Drop changes that could not be saved and save nothing more, so they
+    // cannot reach the files later after being reported as failed
+    void abandonChanges() {
+        journal.discard();
+        abandoned = true;
+    }
+
+    // Turn the OK results of changes that could not be saved, which start
+    // at the given offsets in results, into errors
+    static void markUnsaved(string& results, const DynamicArray<size_t>& changes) {
+        string marked;
+        size_t copied = 0;
+        for (size_t start : changes) {
+            if (results.compare(start, 2, "OK") != 0) {
                 continue;
             }
-            
-            // Check if ISBN contains only digits and 'x'
-            bool onlyDigitsAndX = true;
-            int digitCount = 0;
-            int xCount = 0;
-            
-            for (char c : isbn) {
-                if (isdigit(c)) {
-                    digitCount++;
-                } else if (c == 'x' || c == 'X') {
-                    xCount++;
+            marked.append(results, copied, start - copied);
+            marked += UNSAVED_RESULT;
+            copied = results.find('\n', start) + 1;
+        }
+        marked.append(results, copied, string::npos);
+        results.swap(marked);
+    }
+
+    // Fold the journal into the snapshot, as on exit
+    bool saveCatalog() {
+        return checkpoint();
+    }
+
+    // Run commands read from input, one per line, and write each one's
+    // result to standard output:
+    //   ADD record, EDIT record, DEL id       OK
+    //   GET id                                OK record
+    //   ISBN isbn, FIND / PREFIX / SIMILAR words
+    //                                         OK n, then n records
+    //   LIST added|title|id|year|edition size [page | cursor]
+    //                                         OK n first total cursor (or -),
+    //                                         then n records
+    //   FILTER from-to [category]             OK n, then n records
+    //   COUNT [from-to [category]]            OK n
+    // A failed command gives "ERR message". Blank lines and lines starting
+    // with '#' are skipped. Commands are run as they arrive; the changes of
+    // everything received together are committed with one journal sync
+    // before any of their results are written. If that fails, their results
+    // become "ERR could not save changes", as do those of every later change.
+    // Returns false if changes could not be saved.
+    bool runBatch(FILE* input) {
+        LineReader reader(input);
+        string line;
+        string results;
+        DynamicArray<size_t> changes;
+        bool changed = false;
+        bool saved = true;
+        size_t grouped = 0;
+        while (reader.next(line)) {
+            line = trimString(line);
+            if (!line.empty() && line[0] != '#') {
+                if (!isChangingCommand(line)) {
+                    runCommand(line, results, changed);
+                } else if (!saved) {
+                    results += UNSAVED_RESULT;
                 } else {
-                    onlyDigitsAndX = false;
+                    changes.push_back(results.size());
+                    runCommand(line, results, changed);
+                }
+                ++grouped;
+            }
+            if (reader.pending() == 0 || grouped >= MAX_BATCH_GROUP) {
+                saved = finishBatchGroup(results, changes, changed) && saved;
+                grouped = 0;
+            }
+        }
+        saved = finishBatchGroup(results, changes, changed) && saved;
+        return saved && saveCatalog();
+    }
+
+    void run() {
+        bool running = true;
+        
+        while (running) {
+            compactIfNeeded();
+            checkpointIfNeeded();
+            int choice = getMenuChoice();
+
+            switch (choice) {
+                case 1: addBook(); break;
+                case 2: editBook(); break;
+                case 3: searchBook(); break;
+                case 4: deleteBook(); break;
+                case 5: viewBooksByCategory(); break;
+                case 6: viewAllBooks(); break;
+                case 7: importBooks(); break;
+                case 8: exportBooks(); break;
+                case 9: 
+                    cout << "Exiting Library Management System...\n";
+                    checkpoint();
+                    running = false;
                     break;
+            }
+        }
+    }
+};
+
+#ifdef LMS_SERVER
+// Open a stream socket for "unix:PATH" or "[HOST:]PORT" and either listen
+// on it or connect it. HOST defaults to 127.0.0.1. Returns -1 with error
+// set on failure.
+int openSocket(const string& address, bool listening, string& error) {
+    if (address.compare(0, 5, "unix:") == 0) {
+        string path = address.substr(5);
+        sockaddr_un place{};
+        if (path.empty() || path.size() >= sizeof(place.sun_path)) {
+            error = "bad socket path '" + path + "'";
+            return -1;
+        }
+        place.sun_family = AF_UNIX;
+        memcpy(place.sun_path, path.c_str(), path.size() + 1);
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            error = strerror(errno);
+            return -1;
+        }
+        bool stale = listening && connect(fd, (sockaddr*) &place, sizeof(place)) != 0 && errno == ECONNREFUSED;
+        if (listening) {
+            // A socket nobody answers on is left over from an earlier run
+            close(fd);
+            fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (stale) {
+                unlink(path.c_str());
+            }
+        }
+        bool opened = fd >= 0 && (listening ? bind(fd, (sockaddr*) &place, sizeof(place)) == 0 && listen(fd, SOMAXCONN) == 0
+                                            : connect(fd, (sockaddr*) &place, sizeof(place)) == 0);
+        if (!opened) {
+            error = path + ": " + strerror(errno);
+            if (fd >= 0) {
+                close(fd);
+            }
+            return -1;
+        }
+        return fd;
+    }
+
+    size_t colon = address.rfind(':');
+    string host = colon == string::npos ? "127.0.0.1" : address.substr(0, colon);
+    string port = colon == string::npos ? address : address.substr(colon + 1);
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    addrinfo* found = nullptr;
+    int failure = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &found);
+    if (failure != 0) {
+        error = address + ": " + gai_strerror(failure);
+        return -1;
+    }
+    int fd = -1;
+    string failed = "no usable address";
+    for (addrinfo* option = found; option != nullptr && fd < 0; option = option->ai_next) {
+        fd = socket(option->ai_family, option->ai_socktype | SOCK_CLOEXEC, option->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        int on = 1;
+        bool opened;
+        if (listening) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            opened = bind(fd, option->ai_addr, option->ai_addrlen) == 0 && listen(fd, SOMAXCONN) == 0;
+        } else {
+            opened = connect(fd, option->ai_addr, option->ai_addrlen) == 0;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        }
+        if (!opened) {
+            failed = strerror(errno);
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    if (fd < 0) {
+        error = address + ": " + failed;
+    }
+    return fd;
+}
+
+// Serves the batch commands to many clients at once over a socket. One
+// thread owns every connection and waits on them with epoll; it hands the
+// complete lines a client has sent to a pool of workers and writes back
+// what they produce. A connection has at most one group of lines with the
+// workers at a time, so its results come back in the order it sent them.
+//
+// Reads never wait for writes. The server keeps two copies of the catalog,
+// the one given to it, which owns the journal, and a replica: readers use
+// whichever copy readSide names. The writer moves the readers to the
+// replica, changes the catalog's own copy and commits, points readSide at
+// it, waits for the readers still on the replica to leave, and then repeats
+// the same changes there. Readers so never see a change before it is saved;
+// if a commit fails, they stay on the replica and no more changes are
+// taken. A reader only bumps a counter on its own cache line, so reads
+// scale with the cores serving them.
+class CatalogServer {
+private:
+    struct Connection {
+        int socket;
+        size_t index;      // position in clients
+        string input;      // received lines not yet handed to a worker
+        string output;     // results not yet sent
+        size_t sent;       // how much of output has gone
+        uint32_t watching; // epoll events asked for
+        bool reading;      // the client may still send
+        bool busy;         // a worker has its lines
+        bool failed;       // the connection broke; drop it when idle
+        bool closed;       // dropped; freed once the events in hand are done
+
+        Connection(int descriptor, size_t position)
+            : socket(descriptor), index(position), sent(0), watching(0), reading(true), busy(false), failed(false),
+              closed(false) {}
+    };
+
+    // A group of lines for a worker, or their results on the way back
+    struct Task {
+        Connection* connection;
+        string text;
+
+        Task() : connection(nullptr) {}
+    };
+
+    // Past this much unanswered input or unsent output a client is not read
+    // from until it catches up; a line longer than this is refused
+    static constexpr size_t MAX_PENDING = 16 << 20;
+    static constexpr int MAX_EVENTS = 256;
+    static constexpr size_t READER_STRIPES = 64;
+
+    // Readers on one copy, counted per worker so they do not share a line
+    struct alignas(64) ReaderCount {
+        atomic<long> count;
+
+        ReaderCount() : count(0) {}
+    };
+
+    LibraryManagementSystem* copies[2];
+    LibraryManagementSystem replica;
+    atomic<int> readSide;
+    ReaderCount readers[2][READER_STRIPES];
+    mutex writeLock;
+    bool saved;
+    int listener;
+    int poller;
+    int wakeup;
+    int signals;
+    string socketPath;  // removed again on the way out
+    DynamicArray<Connection*> clients;
+    DynamicArray<Connection*> closedClients;
+    DynamicArray<thread> workers;
+
+    mutex taskLock;
+    condition_variable taskReady;
+    DynamicArray<Task> tasks;
+    size_t nextTask;
+    DynamicArray<Task> finished;
+    bool stopping;
+
+    bool watch(int fd, uint32_t events, void* source, int operation) {
+        epoll_event event{};
+        event.events = events;
+        event.data.ptr = source;
+        return epoll_ctl(poller, operation, fd, &event) == 0;
+    }
+
+    void acceptClients() {
+        for (;;) {
+            int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    cout << "Warning: could not accept a connection (" << strerror(errno) << ").\n";
                 }
+                return;
             }
-            
-            if (!onlyDigitsAndX) {
-                cout << "Invalid ISBN! ISBN must contain only digits and 'x'.\n";
-                continue;
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            Connection* connection = new Connection(fd, clients.length());
+            clients.push_back(connection);
+            connection->watching = EPOLLIN | EPOLLRDHUP;
+            watch(fd, connection->watching, connection, EPOLL_CTL_ADD);
+        }
+    }
+
+    // Stop watching a broken connection; it is closed once no worker has it
+    void abandon(Connection* connection) {
+        if (!connection->failed) {
+            connection->failed = true;
+            connection->input.clear();
+            connection->output.clear();
+            connection->sent = 0;
+            epoll_ctl(poller, EPOLL_CTL_DEL, connection->socket, nullptr);
+        }
+    }
+
+    void receive(Connection* connection) {
+        char chunk[64 * 1024];
+        while (connection->input.size() < MAX_PENDING) {
+            ssize_t got = recv(connection->socket, chunk, sizeof(chunk), 0);
+            if (got > 0) {
+                connection->input.append(chunk, static_cast<size_t>(got));
+            } else if (got == 0) {
+                connection->reading = false;
+                return;
+            } else if (errno != EINTR) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    abandon(connection);
+                }
+                return;
+            }
+        }
+    }
+
+    void transmit(Connection* connection) {
+        string& output = connection->output;
+        while (connection->sent < output.size()) {
+            ssize_t gone = send(connection->socket, output.data() + connection->sent, output.size() - connection->sent,
+                                MSG_NOSIGNAL);
+            if (gone > 0) {
+                connection->sent += static_cast<size_t>(gone);
+            } else if (errno != EINTR) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    abandon(connection);
+                }
+                return;
+            }
+        }
+        output.clear();
+        connection->sent = 0;
+    }
+
+    // Hand the complete lines a connection has sent to the workers. Once the
+    // client has stopped sending, a last line without a newline counts too.
+    void dispatch(Connection* connection) {
+        string& input = connection->input;
+        if (connection->busy || connection->failed || input.empty()) {
+            return;
+        }
+        size_t end = connection->reading ? input.rfind('\n') : input.size() - 1;
+        if (end == string::npos) {
+            if (input.size() >= MAX_PENDING) {
+                connection->output += "ERR line too long\n";
+                connection->reading = false;
+                input.clear();
+            }
+            return;
+        }
+        Task task;
+        task.connection = connection;
+        task.text.assign(input, 0, end + 1);
+        input.erase(0, end + 1);
+        connection->busy = true;
+        {
+            lock_guard<mutex> lock(taskLock);
+            tasks.push_back(std::move(task));
+        }
+        taskReady.notify_one();
+    }
+
+    // Close a connection that is finished with, or adjust what to wait for
+    void settle(Connection* connection) {
+        if (connection->busy) {
+            return;
+        }
+        if (connection->failed || (!connection->reading && connection->input.empty() && connection->output.empty())) {
+            if (!connection->failed) {
+                epoll_ctl(poller, EPOLL_CTL_DEL, connection->socket, nullptr);
+            }
+            close(connection->socket);
+            Connection* last = clients[clients.length() - 1];
+            clients[connection->index] = last;
+            last->index = connection->index;
+            clients.pop_back();
+            // Later events from the same wait may still name it
+            connection->closed = true;
+            closedClients.push_back(connection);
+            return;
+        }
+        bool roomy = connection->input.size() < MAX_PENDING && connection->output.size() < MAX_PENDING;
+        uint32_t wanted = 0;
+        if (connection->reading && roomy) {
+            wanted |= EPOLLIN | EPOLLRDHUP;
+        }
+        if (!connection->output.empty()) {
+            wanted |= EPOLLOUT;
+        }
+        if (wanted != connection->watching) {
+            connection->watching = wanted;
+            watch(connection->socket, wanted, connection, EPOLL_CTL_MOD);
+        }
+    }
+
+    void serviceClient(Connection* connection, uint32_t events) {
+        if (connection->closed) {
+            return;
+        }
+        if (events & (EPOLLERR | EPOLLHUP)) {
+            abandon(connection);
+        } else {
+            if (events & (EPOLLIN | EPOLLRDHUP)) {
+                receive(connection);
+            }
+            if (!connection->failed) {
+                transmit(connection);
+            }
+            dispatch(connection);
+        }
+        settle(connection);
+    }
+
+    // Pass what the workers have finished back to their connections
+    void deliverResults() {
+        eventfd_t count;
+        eventfd_read(wakeup, &count);
+        DynamicArray<Task> done;
+        {
+            lock_guard<mutex> lock(taskLock);
+            done = std::move(finished);
+        }
+        for (Task& task : done) {
+            Connection* connection = task.connection;
+            connection->busy = false;
+            if (!connection->failed) {
+                connection->output += task.text;
+                transmit(connection);
+            }
+            dispatch(connection);
+            settle(connection);
+        }
+    }
+
+    // Enter whichever copy readers are using, announcing it on stripe
+    int beginRead(size_t stripe) {
+        for (;;) {
+            int side = readSide.load();
+            readers[side][stripe].count.fetch_add(1);
+            if (readSide.load() == side) {
+                return side;
             }
-            
-            // Check if the ISBN has the correct number of digits (10 or 13)
-            if (digitCount + xCount != 10 && digitCount + xCount != 13) {
-                cout << "Invalid ISBN! ISBN must contain exactly 10 or 13 characters (digits and 'x').\n";
-                continue;
+            // The writer switched copies meanwhile and may not have seen us
+            readers[side][stripe].count.fetch_sub(1);
+        }
+    }
+
+    void endRead(int side, size_t stripe) {
+        readers[side][stripe].count.fetch_sub(1, memory_order_release);
+    }
+
+    void waitForReaders(int side) {
+        for (size_t stripe = 0; stripe < READER_STRIPES; ++stripe) {
+            while (readers[side][stripe].count.load(memory_order_acquire) != 0) {
+                this_thread::yield();
             }
-            
-            validInput = true;
-            
-        } while (!validInput);
-        
-        return isbn;
+        }
     }
 
-    string getValidInput(const string& prompt, bool allowEmpty = false) {
-        string input;
-        bool validInput = false;
-        
-        do {
-            cout << prompt;
-            getline(cin, input);
-            input = trimString(input);
-            
-            if (!input.empty() || allowEmpty) {
-                validInput = true;
-            } else {
-                cout << "Input cannot be empty. Please try again.\n";
+    // Apply a run of changing commands to both copies, committing them
+    // before readers can see them. Once a commit has failed every change is
+    // refused.
+    void runWrites(const DynamicArray<string>& lines, string& results) {
+        lock_guard<mutex> lock(writeLock);
+        if (!saved) {
+            for (size_t i = 0; i < lines.length(); ++i) {
+                results += LibraryManagementSystem::UNSAVED_RESULT;
             }
-        } while (!validInput);
-        
-        return input;
+            return;
+        }
+        readSide.store(1);
+        waitForReaders(0);
+
+        DynamicArray<size_t> changes;
+        bool changed = false;
+        for (const string& line : lines) {
+            changes.push_back(results.size());
+            copies[0]->runCommand(line, results, changed);
+        }
+        bool settled = copies[0]->settleChanges(changed);
+        copies[0]->prepareWordSearch();
+        if (!settled) {
+            // The replica readers are on never had these changes
+            copies[0]->abandonChanges();
+            LibraryManagementSystem::markUnsaved(results, changes);
+            saved = false;
+            return;
+        }
+        readSide.store(0);
+        waitForReaders(1);
+
+        string repeated;
+        changed = false;
+        for (const string& line : lines) {
+            copies[1]->runCommand(line, repeated, changed);
+        }
+        copies[1]->settleChanges(changed);
+        copies[1]->prepareWordSearch();
     }
-    
-    string getValidId() {
-        string id;
-        bool validInput = false;
-        
-        do {
-            id = getValidInput("Enter Book ID: ");
-            
-            if (!isValidId(id)) {
-                cout << "Invalid ID! ID must be alphanumeric.\n";
-                continue;
+
+    // Run a group of lines in order. Reads go straight to the copy in use;
+    // consecutive changes are applied together.
+    void runLines(const string& text, size_t stripe, string& results) {
+        DynamicArray<string> writes;
+        size_t start = 0;
+        while (start < text.size()) {
+            size_t end = text.find('\n', start);
+            if (end == string::npos) {
+                end = text.size();
             }
-            
-            if (!isIdUnique(id)) {
-                cout << "Duplicate ID! Please enter a unique ID.\n";
+            string line = trimString(text.substr(start, end - start));
+            start = end + 1;
+            if (line.empty() || line[0] == '#') {
                 continue;
             }
-            
-            validInput = true;
-        } while (!validInput);
-        
-        return id;
-    }
-    
-    string getValidCategory() {
-        string category;
-        bool validInput = false;
-        
-        do {
-            category = getValidInput("Enter Book Category (Fiction/Non-fiction): ");
-            
-            if (isValidCategory(category)) {
-                // Normalize category to maintain consistency
-                string lowerCategory = toLowercase(category);
-                if (lowerCategory == "non fiction" || lowerCategory == "non-fiction" || lowerCategory == "nonfiction") {
-                    category = "Non-fiction";
-                } else if (lowerCategory == "fiction") {
-                    category = "Fiction";
+            if (!LibraryManagementSystem::isChangingCommand(line)) {
+                if (!writes.empty()) {
+                    runWrites(writes, results);
+                    writes.clear();
                 }
-                validInput = true;
+                bool changed = false;
+                int side = beginRead(stripe);
+                copies[side]->runCommand(line, results, changed);
+                endRead(side, stripe);
             } else {
-                cout << "Category not found! Please enter a valid category.\n";
+                writes.push_back(std::move(line));
             }
-        } while (!validInput);
-        
-        return category;
+        }
+        if (!writes.empty()) {
+            runWrites(writes, results);
+        }
     }
-    
-    string getValidPublication() {
-        string publication;
-        bool validInput = false;
-        
-        do {
-            publication = getValidInput("Enter Publication Year (4 digits): ");
-            
-            // Check if the input is a 4-digit year 
-            bool isValidYear = true;
-            if (publication.length() != 4) {
-                isValidYear = false;
-            } else {
-                for (char c : publication) {
-                    if (!isdigit(c)) {
-                        isValidYear = false;
-                        break;
-                    }
+
+    void work(size_t stripe) {
+        Task task;
+        string results;
+        for (;;) {
+            {
+                unique_lock<mutex> lock(taskLock);
+                taskReady.wait(lock, [this] { return nextTask < tasks.length() || stopping; });
+                if (nextTask == tasks.length()) {
+                    return;
                 }
-            }
-            
-            if (isValidYear) {
-                int year = stoi(publication);
-                if (year >= 1000 && year <= 2100) {
-                    validInput = true;
-                } else {
-                    cout << "Invalid year! Year must be between 1000 and 2100.\n";
+                task = std::move(tasks[nextTask++]);
+                if (nextTask == tasks.length()) {
+                    tasks.clear();
+                    nextTask = 0;
                 }
-            } else {
-                cout << "Invalid publication year! Publication must be a 4-digit year.\n";
             }
-        } while (!validInput);
-        
-        return publication;
+            results.clear();
+            runLines(task.text, stripe, results);
+            task.text.swap(results);
+            {
+                lock_guard<mutex> lock(taskLock);
+                finished.push_back(std::move(task));
+            }
+            eventfd_write(wakeup, 1);
+        }
     }
-    
-    string getValidSearchId() {
-        string id;
-        bool validInput = false;
-        
-        do {
-            cout << "Enter Book ID to search: ";
-            getline(cin, id);
-            id = trimString(id);
-            
-            if (id.empty()) {
-                cout << "ID cannot be empty. Please try again.\n";
-                continue;
+
+public:
+    // Constructor. lms owns the catalog's files; the replica is loaded from
+    // the same ones and so doubles the memory the catalog takes.
+    CatalogServer(LibraryManagementSystem& lms, const string& catalogPath)
+        : replica(catalogPath, true), readSide(0), saved(true), listener(-1), poller(-1), wakeup(-1), signals(-1),
+          nextTask(0), stopping(false) {
+        copies[0] = &lms;
+        copies[1] = &replica;
+    }
+
+    // Destructor
+    ~CatalogServer() {
+        for (Connection* connection : clients) {
+            close(connection->socket);
+            delete connection;
+        }
+        for (Connection* connection : closedClients) {
+            delete connection;
+        }
+        for (int fd : {listener, poller, wakeup, signals}) {
+            if (fd >= 0) {
+                close(fd);
             }
-            
-            // Check if ID contains only alphanumeric characters
-            bool isAlphanumeric = true;
-            for (char c : id) {
-                if (!isalnum(c)) {
-                    isAlphanumeric = false;
-                    break;
+        }
+        if (!socketPath.empty()) {
+            unlink(socketPath.c_str());
+        }
+    }
+
+    // Listen on "unix:PATH" or "[HOST:]PORT"; false with error set on failure
+    bool listenOn(const string& address, string& error) {
+        listener = openSocket(address, true, error);
+        if (listener < 0) {
+            return false;
+        }
+        fcntl(listener, F_SETFL, fcntl(listener, F_GETFL) | O_NONBLOCK);
+        if (address.compare(0, 5, "unix:") == 0) {
+            socketPath = address.substr(5);
+        }
+        return true;
+    }
+
+    // Serve clients with workerCount workers until interrupted or
+    // terminated. Returns false if some change could not be saved.
+    bool serve(size_t workerCount) {
+        sigset_t stopSignals;
+        sigemptyset(&stopSignals);
+        sigaddset(&stopSignals, SIGINT);
+        sigaddset(&stopSignals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+        signals = signalfd(-1, &stopSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+        poller = epoll_create1(EPOLL_CLOEXEC);
+        wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (signals < 0 || poller < 0 || wakeup < 0 || !watch(listener, EPOLLIN, &listener, EPOLL_CTL_ADD)
+            || !watch(wakeup, EPOLLIN, &wakeup, EPOLL_CTL_ADD) || !watch(signals, EPOLLIN, &signals, EPOLL_CTL_ADD)) {
+            cout << "Could not start the server (" << strerror(errno) << ").\n";
+            return false;
+        }
+
+        for (LibraryManagementSystem* copy : copies) {
+            copy->prepareSharedReads();
+            copy->prepareWordSearch();
+        }
+        for (size_t i = 0; i < workerCount; ++i) {
+            workers.push_back(thread(&CatalogServer::work, this, i % READER_STRIPES));
+        }
+
+        epoll_event ready[MAX_EVENTS];
+        bool running = true;
+        while (running) {
+            int count = epoll_wait(poller, ready, MAX_EVENTS, -1);
+            if (count < 0 && errno != EINTR) {
+                cout << "Server stopped (" << strerror(errno) << ").\n";
+                break;
+            }
+            for (int i = 0; i < count; ++i) {
+                void* source = ready[i].data.ptr;
+                if (source == &listener) {
+                    acceptClients();
+                } else if (source == &wakeup) {
+                    deliverResults();
+                } else if (source == &signals) {
+                    // Take the signal so it is not delivered once unblocked
+                    signalfd_siginfo received;
+                    running = read(signals, &received, sizeof(received)) != (ssize_t) sizeof(received);
+                } else {
+                    serviceClient((Connection*) source, ready[i].events);
                 }
             }
-            
-            if (!isAlphanumeric) {
-                cout << "Invalid ID! ID must contain only alphanumeric characters (no spaces or special characters).\n";
-                continue;
+            for (Connection* connection : closedClients) {
+                delete connection;
             }
-            
-            validInput = true;
-        } while (!validInput);
-        
-        return id;
+            closedClients.clear();
+        }
+
+        // Let the workers finish what they were given so its changes are kept
+        {
+            lock_guard<mutex> lock(taskLock);
+            stopping = true;
+        }
+        taskReady.notify_all();
+        for (thread& worker : workers) {
+            worker.join();
+        }
+        deliverResults();
+        pthread_sigmask(SIG_UNBLOCK, &stopSignals, nullptr);
+        return saved;
     }
-    
-    StringArray getMultipleAuthors() {
-        StringArray authors;
-        int authorCount = 0;
-        bool validCount = false;
-        
-        do {
-            string input = getValidInput("Enter the number of authors: ");
-            
-            bool isNumber = true;
-            for (char c : input) {
-                if (!isdigit(c)) {
-                    isNumber = false;
-                    break;
+};
+
+// Measures a running server: each client keeps a window of pipelined GET
+// requests for books the server holds in flight, and the round trips are
+// timed until the run is over.
+class LoadGenerator {
+private:
+    struct Client {
+        size_t requests;
+        DynamicArray<double> roundTrips;  // milliseconds per window
+        string error;
+
+        Client() : requests(0) {}
+    };
+
+    // Read from fd onto text until it holds lines newlines
+    static bool readLines(int fd, size_t lines, string& text, string& error) {
+        char chunk[64 * 1024];
+        size_t seen = static_cast<size_t>(count(text.begin(), text.end(), '\n'));
+        while (seen < lines) {
+            ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+            if (got <= 0) {
+                if (got < 0 && errno == EINTR) {
+                    continue;
                 }
+                error = got == 0 ? "server closed the connection" : strerror(errno);
+                return false;
             }
-            
-            if (!isNumber) {
-                cout << "Invalid input! Please enter a valid number.\n";
-                continue;
+            text.append(chunk, static_cast<size_t>(got));
+            seen += static_cast<size_t>(count(chunk, chunk + got, '\n'));
+        }
+        return true;
+    }
+
+    static bool sendAll(int fd, const string& text, string& error) {
+        for (size_t sent = 0; sent < text.size();) {
+            ssize_t gone = send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+            if (gone < 0 && errno != EINTR) {
+                error = strerror(errno);
+                return false;
             }
-            
-            authorCount = stoi(input);
-            if (authorCount <= 0) {
-                cout << "Number of authors must be positive. Please try again.\n";
-                continue;
+            sent += gone > 0 ? static_cast<size_t>(gone) : 0;
+        }
+        return true;
+    }
+
+    // The IDs of up to limit books, still escaped for sending back
+    static bool sampleIds(const string& address, size_t limit, DynamicArray<string>& ids, string& error) {
+        int fd = openSocket(address, false, error);
+        if (fd < 0) {
+            return false;
+        }
+        string reply;
+        bool fetched = sendAll(fd, "LIST id " + to_string(limit) + " 0\n", error) && readLines(fd, 1, reply, error);
+        size_t books = fetched ? strtoul(reply.c_str() + 3, nullptr, 10) : 0;
+        if (fetched && reply.compare(0, 3, "OK ") != 0) {
+            error = "server answered " + reply.substr(0, reply.find('\n'));
+            fetched = false;
+        }
+        fetched = fetched && readLines(fd, books + 1, reply, error);
+        close(fd);
+        if (!fetched) {
+            return false;
+        }
+        size_t start = reply.find('\n') + 1;
+        for (size_t i = 0; i < books; ++i) {
+            size_t end = reply.find('\n', start);
+            size_t field = start;
+            while (field < end && reply[field] != '|') {
+                field += reply[field] == '\\' ? 2u : 1u;
             }
-            
-            validCount = true;
-        } while (!validCount);
-        
-        for (int i = 0; i < authorCount; ++i) {
-            string author = getValidInput("Enter Author " + to_string(i + 1) + ": ");
-            authors.push_back(author);
+            ids.push_back(reply.substr(start, field - start));
+            start = end + 1;
         }
-        
-        return authors;
+        return true;
     }
-    
-    int findBookIndexById(const string& id) const {
-        for (int i = 0; i < bookCount; ++i) {
-            if (caseInsensitiveCompare(books[i].getId(), id)) {
-                return i;
+
+    static void runClient(const string& address, const DynamicArray<string>& ids, size_t window, size_t seed,
+                          chrono::steady_clock::time_point until, Client& client) {
+        int fd = openSocket(address, false, client.error);
+        if (fd < 0) {
+            return;
+        }
+        string requests;
+        string replies;
+        uint64_t state = seed * 0x9E3779B97F4A7C15ull + 1;
+        while (chrono::steady_clock::now() < until) {
+            requests.clear();
+            for (size_t i = 0; i < window; ++i) {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                requests += "GET ";
+                requests += ids[state % ids.length()];
+                requests += '\n';
+            }
+            replies.clear();
+            auto start = chrono::steady_clock::now();
+            if (!sendAll(fd, requests, client.error) || !readLines(fd, window, replies, client.error)) {
+                break;
             }
+            chrono::duration<double, milli> took = chrono::steady_clock::now() - start;
+            client.roundTrips.push_back(took.count());
+            client.requests += window;
         }
-        return -1;
+        close(fd);
     }
-    
-    void pressAnyContinue() {
-        cout << "Press Enter to Continue...";
-        cin.get();
+
+public:
+    // Drive the server at address with clients connections for the given
+    // number of seconds and report the throughput and round-trip times.
+    // Returns false if the server could not be reached or held no books.
+    static bool run(const string& address, size_t clients, size_t window, double seconds) {
+        DynamicArray<string> ids;
+        string error;
+        if (!sampleIds(address, 10000, ids, error)) {
+            cerr << "Could not reach " << address << " (" << error << ").\n";
+            return false;
+        }
+        if (ids.empty()) {
+            cerr << "The catalog at " << address << " has no books to ask for.\n";
+            return false;
+        }
+
+        DynamicArray<Client> results;
+        results.resize(clients);
+        DynamicArray<thread> threads;
+        auto start = chrono::steady_clock::now();
+        auto until = start + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+        for (size_t i = 0; i < clients; ++i) {
+            threads.push_back(thread(runClient, cref(address), cref(ids), window, i + 1, until, ref(results[i])));
+        }
+        for (thread& client : threads) {
+            client.join();
+        }
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+        size_t requests = 0;
+        DynamicArray<double> roundTrips;
+        for (const Client& client : results) {
+            if (!client.error.empty()) {
+                cerr << "A client stopped early (" << client.error << ").\n";
+            }
+            requests += client.requests;
+            for (double took : client.roundTrips) {
+                roundTrips.push_back(took);
+            }
+        }
+        sort(roundTrips.begin(), roundTrips.end());
+        auto percentile = [&roundTrips](double fraction) {
+            if (roundTrips.empty()) {
+                return 0.0;
+            }
+            return roundTrips[static_cast<size_t>(fraction * static_cast<double>(roundTrips.length() - 1))];
+        };
+        cout << fixed << setprecision(3)
+             << "clients=" << clients << " window=" << window << " requests=" << requests
+             << " seconds=" << elapsed.count() << " requests_per_second=" << setprecision(0)
+             << static_cast<double>(requests) / elapsed.count()
+             << setprecision(3) << " round_trip_ms_p50=" << percentile(0.5) << " round_trip_ms_p99=" << percentile(0.99)
+             << "\n";
+        return true;
     }
+};
+#endif
 
-    void displayBookDetails(const Book& book) {
-        cout << left 
-             << setw(15) << book.getId()
-             << setw(15) << book.getValidIsbn()
-             << setw(20) << book.getTitle()
-             << setw(40) << book.getAuthorsAsString()
-             << setw(10) << book.getEdition()
-             << setw(15) << book.getPublication()
-             << setw(15) << book.getCategory() << endl;
+#ifdef LMS_BENCH
+// Heap allocations made by each thread, counted for the benchmarks. Only
+// builds with LMS_BENCH defined replace operator new to count them.
+thread_local uint64_t allocationCount = 0;
+
+void* operator new(size_t size) {
+    ++allocationCount;
+    void* block = malloc(size == 0 ? 1 : size);
+    if (block == nullptr) {
+        throw bad_alloc();
+    }
+    return block;
+}
+
+void operator delete(void* block) noexcept {
+    free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    free(block);
+}
+#endif
+
+// Times the core catalog operations on synthetic catalogs of 1000 books up
+// to a given size, ten times larger at each step. Books get one to five
+// authors. Each result is one line of key=value pairs:
+//   books=N op=NAME ops=N ns_per_op=X allocs_per_op=X peak_rss_kb=N
+// allocs_per_op is only there in builds with LMS_BENCH defined. The
+// catalogs live only in memory; nothing is written to disk.
+class CatalogBenchmark {
+private:
+    // Lookups and renders are repeated up to at least this many operations
+    // so small catalogs still give steady timings
+    static constexpr size_t MIN_REPEATS = 200000;
+    static constexpr const char* NO_FILE = "/dev/null/benchmark.dat";
+
+    struct Measurement {
+        chrono::steady_clock::time_point start;
+#ifdef LMS_BENCH
+        uint64_t allocations;
+
+        Measurement() : start(chrono::steady_clock::now()), allocations(allocationCount) {}
+#else
+        Measurement() : start(chrono::steady_clock::now()) {}
+#endif
+    };
+
+    uint64_t state;
+
+    uint64_t nextRandom() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    static size_t peakResidentKb() {
+#ifdef LMS_POSIX
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<size_t>(usage.ru_maxrss);
+#else
+        return 0;
+#endif
+    }
+
+    static void report(size_t books, const char* operation, size_t ops, const Measurement& since) {
+        chrono::duration<double, nano> took = chrono::steady_clock::now() - since.start;
+        cout << fixed << "books=" << books << " op=" << operation << " ops=" << ops
+             << " ns_per_op=" << setprecision(2) << took.count() / static_cast<double>(ops) << setprecision(3);
+#ifdef LMS_BENCH
+        uint64_t allocations = allocationCount - since.allocations;
+        cout << " allocs_per_op=" << static_cast<double>(allocations) / static_cast<double>(ops);
+#endif
+        cout << " peak_rss_kb=" << peakResidentKb() << endl;
+    }
+
+    static string bookId(size_t number) {
+        string id = to_string(number);
+        return "B" + string(id.size() < 8 ? 8 - id.size() : 0, '0') + id;
     }
 
-    bool getYesNoInput(const string& prompt) {
-        string input;
-        bool validInput = false;
-        bool result = false;
-        
-        do {
-            input = getValidInput(prompt);
-            
-            if (caseInsensitiveCompare(input, "yes") || 
-                caseInsensitiveCompare(input, "y")) {
-                result = true;
-                validInput = true;
-            } else if (caseInsensitiveCompare(input, "no") || 
-                       caseInsensitiveCompare(input, "n")) {
-                result = false;
-                validInput = true;
-            } else {
-                cout << "Invalid input. Please enter 'yes' or 'no'.\n";
-            }
-        } while (!validInput);
-        
-        return result;
+    Book makeBook(size_t number) {
+        static const char* const WORDS[] = {
+            "river", "shadow", "garden", "winter", "empire", "silent", "golden", "stone", "journey", "night",
+            "ocean", "memory", "fire", "city", "secret", "light", "history", "science", "modern", "war"};
+        static const char* const NAMES[] = {
+            "Adams", "Baker", "Chen", "Diaz", "Evans", "Fischer", "Garcia", "Hughes", "Ito", "Jones",
+            "Kowalski", "Lopez", "Moreau", "Nguyen", "Okafor", "Patel", "Quinn", "Rossi", "Smith", "Tanaka"};
+        static const char* const EDITIONS[] = {"1st", "2nd", "3rd", "4th"};
+        const size_t wordCount = sizeof(WORDS) / sizeof(WORDS[0]);
+        const size_t nameCount = sizeof(NAMES) / sizeof(NAMES[0]);
+
+        string title;
+        for (size_t words = 1 + nextRandom() % 4; words > 0; --words) {
+            title += title.empty() ? "" : " ";
+            title += WORDS[nextRandom() % wordCount];
+        }
+        StringArray authors;
+        // Mostly one author, sometimes up to five
+        size_t authorCount = 1 + (nextRandom() % 8 == 0 ? nextRandom() % 5 : 0);
+        for (size_t i = 0; i < authorCount; ++i) {
+            authors.push_back(string(NAMES[nextRandom() % nameCount]) + " " + to_string(nextRandom() % 1000));
+        }
+        string isbn = "978" + to_string(1000000000 + nextRandom() % 9000000000ull);
+        return Book(bookId(number), isbn, title, std::move(authors), EDITIONS[nextRandom() % 4],
+                    to_string(1900 + nextRandom() % 125), nextRandom() % 2 ? "Fiction" : "Non-fiction");
     }
 
-public:
-    LibraryManagementSystem() : bookCount(0) {}
+    void run(size_t size) {
+        // Books are numbered in a shuffled order so IDs do not arrive sorted
+        DynamicArray<size_t> numbers;
+        numbers.resize(size);
+        for (size_t i = 0; i < size; ++i) {
+            numbers[i] = i;
+        }
+        for (size_t i = size; i > 1; --i) {
+            swap(numbers[i - 1], numbers[nextRandom() % i]);
+        }
+        DynamicArray<Book> generated;
+        generated.reserve(size);
+        for (size_t number : numbers) {
+            generated.push_back(makeBook(number));
+        }
 
-    void addBook() {
-        bool continuedAdding = true;
-        
-        while (continuedAdding) {
-            if (bookCount >= MAX_BOOKS) {
-                cout << "Library is full. Cannot add more books.\n";
-                return;
+        LibraryManagementSystem lms(NO_FILE, true);
+        lms.prepareSharedReads();
+        {
+            Measurement since;
+            for (Book& book : generated) {
+                lms.insertBook(book);
             }
-    
-            string category = getValidCategory();
-            string id = getValidId();
-            string isbn = getValidIsbn(); 
-            string title = getValidInput("Enter Title: ");
-            StringArray authors = getMultipleAuthors();
-            string edition = getValidInput("Enter Edition: ");
-            string publication = getValidPublication();
-    
-            books[bookCount++] = Book(id, isbn, title, authors, edition, publication, category);
-            cout << "Book added successfully!\n";
-    
-            continuedAdding = getYesNoInput("Would you like to add another book? (yes/no): ");
+            report(size, "add", size, since);
         }
-    }
+        generated = DynamicArray<Book>();
 
-    void editBook() {
-        bool bookFound = false;
-        
-        while (!bookFound) {
-            string id = getValidSearchId();
-            int index = findBookIndexById(id);
-            
-            if (index != -1) {
-                Book& book = books[index];
-                
-                // Update ISBN with proper validation for digits and 'x' only
-                string newIsbn = getValidInput("Enter new ISBN (or press Enter to skip): ", true);
-                if (!newIsbn.empty()) {
-                    // Check if ISBN contains only digits and 'x'
-                    bool onlyDigitsAndX = true;
-                    int digitCount = 0;
-                    int xCount = 0;
-                    
-                    for (char c : newIsbn) {
-                        if (isdigit(c)) {
-                            digitCount++;
-                        } else if (c == 'x' || c == 'X') {
-                            xCount++;
-                        } else {
-                            onlyDigitsAndX = false;
-                            break;
-                        }
-                    }
-                    
-                    if (!onlyDigitsAndX) {
-                        cout << "Invalid ISBN! ISBN must contain only digits and 'x'. Skipping ISBN update.\n";
-                    } else if (digitCount + xCount != 10 && digitCount + xCount != 13) {
-                        cout << "Invalid ISBN! ISBN must contain exactly 10 or 13 characters. Skipping ISBN update.\n";
-                    } else {
-                        book.setIsbn(newIsbn);
-                    }
+        // Edits take the path the edit menu does: copy the stored book,
+        // change its title and authors, then replace it in place
+        {
+            DynamicArray<string> titles;
+            DynamicArray<StringArray> authors;
+            titles.reserve(size);
+            authors.reserve(size);
+            for (size_t i = 0; i < size; ++i) {
+                Book changed = makeBook(numbers[i]);
+                titles.push_back(string(changed.getTitle()));
+                StringArray names;
+                for (string_view author : changed.getAuthors()) {
+                    names.push_back(string(author));
                 }
-                
-                string newTitle = getValidInput("Enter new Title (or press Enter to skip): ", true);
-                if (!newTitle.empty()) book.setTitle(newTitle);
-                
-                // Update authors
-                cout << "Update authors? ";
-                if (getYesNoInput("(yes/no): ")) {
-                    StringArray newAuthors = getMultipleAuthors();
-                    book.setAuthors(newAuthors);
+                authors.push_back(std::move(names));
+            }
+            size_t edited = 0;
+            Measurement since;
+            for (size_t i = 0; i < size; ++i) {
+                int slot = lms.findBookIndexById(bookId(numbers[i]));
+                if (slot == -1) {
+                    continue;
                 }
-                
-                // Update edition as simple string
-                string newEdition = getValidInput("Enter new Edition (or press Enter to skip): ", true);
-                if (!newEdition.empty()) {
-                    book.setEdition(newEdition);
+                Book book = lms.books[static_cast<size_t>(slot)];
+                book.setTitle(titles[i]);
+                book.setAuthors(authors[i]);
+                lms.journal.logEdit(book);
+                lms.replaceBook(slot, book);
+                ++edited;
+            }
+            report(size, "edit", size, since);
+            if (edited != size) {
+                cerr << "Warning: " << size - edited << " edits missed.\n";
+            }
+        }
+
+        size_t repeats = max(size, MIN_REPEATS);
+        DynamicArray<string> ids;
+        ids.reserve(1024);
+        for (size_t i = 0; i < 1024; ++i) {
+            ids.push_back(bookId(nextRandom() % size));
+        }
+        {
+            size_t found = 0;
+            Measurement since;
+            for (size_t i = 0; i < repeats; ++i) {
+                found += lms.findBookIndexById(ids[i % 1024]) != -1;
+            }
+            report(size, "find_by_id", repeats, since);
+            if (found != repeats) {
+                cerr << "Warning: " << repeats - found << " lookups missed.\n";
+            }
+        }
+        for (size_t i = 0; i < 1024; ++i) {
+            ids[i] = "X" + ids[i].substr(1);
+        }
+        {
+            size_t unique = 0;
+            Measurement since;
+            for (size_t i = 0; i < repeats; ++i) {
+                unique += lms.isIdUnique(ids[i % 1024]);
+            }
+            report(size, "is_id_unique", repeats, since);
+            if (unique != repeats) {
+                cerr << "Warning: " << repeats - unique << " IDs were not unique.\n";
+            }
+        }
+
+        // The listings render into a sink, the way the menus render to the screen
+#ifdef _WIN32
+        FILE* sinkFile = fopen("NUL", "wb");
+#else
+        FILE* sinkFile = fopen("/dev/null", "wb");
+#endif
+        if (sinkFile != nullptr) {
+            OutputBuffer sink(sinkFile);
+            BookTable rows(sink);
+            {
+                size_t rendered = 0;
+                Measurement since;
+                while (rendered < repeats) {
+                    rows.writeHeader();
+                    lms.categoryIndex.forEach("Fiction", [&](int slot) {
+                        rows.writeRow(lms.books[static_cast<size_t>(slot)]);
+                        ++rendered;
+                        return true;
+                    });
                 }
-                
-                string newPublication = getValidInput("Enter new Publication Year (or press Enter to skip): ", true);
-                if (!newPublication.empty()) {
-                    // Check if the input is a 4-digit year without using 
-                    bool isValidYear = true;
-                    if (newPublication.length() != 4) {
-                        isValidYear = false;
-                    } else {
-                        for (char c : newPublication) {
-                            if (!isdigit(c)) {
-                                isValidYear = false;
-                                break;
-                            }
-                        }
-                    }
-                    
-                    if (isValidYear) {
-                        int year = stoi(newPublication);
-                        if (year >= 1000 && year <= 2100) {
-                            book.setPublication(newPublication);
-                        } else {
-                            cout << "Invalid year! Year must be between 1000 and 2100. Skipping Publication update.\n";
+                sink.flush();
+                report(size, "view_by_category", rendered, since);
+            }
+            {
+                size_t rendered = 0;
+                Measurement since;
+                while (rendered < repeats) {
+                    for (size_t first = 0; first < lms.titleOrder.length(); first += LibraryManagementSystem::PAGE_SIZE) {
+                        rows.writeHeader();
+                        auto cursor = lms.titleOrder.at(first);
+                        for (size_t i = 0; i < LibraryManagementSystem::PAGE_SIZE && cursor.valid(); ++i, cursor.advance()) {
+                            rows.writeRow(lms.books[static_cast<size_t>(cursor.slot())]);
+                            ++rendered;
                         }
-                    } else {
-                        cout << "Invalid publication year! Publication must be a 4-digit year. Skipping Publication update.\n";
                     }
                 }
-                
-                cout << "Update category? ";
-                if (getYesNoInput("(yes/no): ")) {
-                    book.setCategory(getValidCategory());
-                } else {
-                    cout << "Book category is not updated." << endl;
-                }
-                
-                cout << "Book edited successfully!\n";
-                bookFound = true;
-            } else {
-                cout << "Book not found!\n";
-                if (!getYesNoInput("Do you want to try again? (yes/no): ")) {
-                    bookFound = true;
-                }
+                sink.flush();
+                report(size, "view_all_by_title", rendered, since);
             }
+            fclose(sinkFile);
         }
-    }
-    
-    void searchBook() {
-        bool bookFound = false;
-        
-        while (!bookFound) {
-            string id = getValidSearchId();
-            int index = findBookIndexById(id);
-            
-            if (index != -1) {
-                cout << "\n--- Book Details ---\n";
-                cout << left 
-                     << setw(15) << "ID"
-                     << setw(15) << "ISBN"
-                     << setw(20) << "Title"
-                     << setw(40) << "Authors"
-                     << setw(10) << "Edition"
-                     << setw(15) << "Publication"
-                     << setw(15) << "Category" << endl;
-                displayBookDetails(books[index]);
-                bookFound = true;
-            } else {
-                cout << "Book not found!\n";
-                if (!getYesNoInput("Do you want to try again? (yes/no): ")) {
-                    bookFound = true;
+
+        // Year and category filters; ops counts the books scanned
+        {
+            size_t matched = 0;
+            size_t passes = max<size_t>(1, MIN_REPEATS * 10 / size);
+            Measurement since;
+            for (size_t pass = 0; pass < passes; ++pass) {
+                matched += lms.countBooks(1950, 1999, "");
+            }
+            report(size, "filter_year", passes * size, since);
+            since = Measurement();
+            for (size_t pass = 0; pass < passes; ++pass) {
+                matched += lms.countBooks(1950, 1999, "Fiction");
+            }
+            report(size, "filter_year_category", passes * size, since);
+            if (matched == 0) {
+                cerr << "Warning: the filters matched nothing.\n";
+            }
+        }
+
+        // Category validation over canonical, alternate and unknown spellings
+        {
+            static const string_view SPELLINGS[] = {"Fiction", "non fiction", "NON-FICTION", "Poetry"};
+            size_t known = 0;
+            string canonical;
+            Measurement since;
+            for (size_t i = 0; i < repeats; ++i) {
+                known += normalizeCategory(SPELLINGS[i % 4], canonical);
+            }
+            report(size, "category_lookup", repeats, since);
+            if (known == 0) {
+                cerr << "Warning: no category was recognized.\n";
+            }
+        }
+
+        // Delete half the books, including the compaction that follows
+        for (size_t i = size; i > 1; --i) {
+            swap(numbers[i - 1], numbers[nextRandom() % i]);
+        }
+        {
+            size_t deletes = size / 2;
+            Measurement since;
+            for (size_t i = 0; i < deletes; ++i) {
+                int slot = lms.findBookIndexById(bookId(numbers[i]));
+                if (slot != -1) {
+                    lms.removeBook(slot);
                 }
+                lms.compactIfNeeded();
             }
+            report(size, "delete", deletes, since);
         }
     }
-    
-    void deleteBook() {
-        bool bookFound = false;
-        
-        while (!bookFound) {
-            string id = getValidSearchId();
-            int index = findBookIndexById(id);
-            
-            if (index != -1) {
-                cout << "\n--- Book Details ---\n";
-                cout << left 
-                     << setw(15) << "ID"
-                     << setw(15) << "ISBN"
-                     << setw(20) << "Title"
-                     << setw(40) << "Authors"
-                     << setw(10) << "Edition"
-                     << setw(15) << "Publication"
-                     << setw(15) << "Category" << endl;
-                displayBookDetails(books[index]);
-                
-                if (getYesNoInput("Do you want to delete this book? (yes/no): ")) {
-                    for (int i = index; i < bookCount - 1; ++i) {
-                        books[i] = books[i + 1];
-                    }
-                    bookCount--;
-                    cout << "Book deleted successfully!\n";
-                    bookFound = true;
-                } else {
-                    bookFound = true;
+
+    // Case-insensitive comparison and lowercasing of ID-length and
+    // title-length strings, with the portable kernels and with the ones
+    // picked for this CPU. No catalog is involved, so these report books=0.
+    void runCaseFolding() {
+        const size_t SAMPLES = 64;
+        const size_t repeats = MIN_REPEATS * 10;
+        const CaseFoldKernels kernelSets[] = {{"scalar", foldedMismatchScalar, lowercaseScalar}, caseFold};
+        const size_t setCount = caseFold.mismatch == foldedMismatchScalar ? 1 : 2;
+        for (const char* kind : {"id", "title"}) {
+            // Each sample is compared with an upper-case copy, so every
+            // character has to be folded
+            DynamicArray<string> texts;
+            DynamicArray<string> shouted;
+            for (size_t i = 0; i < SAMPLES; ++i) {
+                string text = strcmp(kind, "id") == 0 ? bookId(nextRandom() % 10000000)
+                                                      : string(makeBook(i).getTitle()) + " " + string(makeBook(i).getTitle());
+                string upper = text;
+                for (char& c : upper) {
+                    c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
                 }
-            } else {
-                cout << "Book not found!\n";
-                if (!getYesNoInput("Do you want to try again? (yes/no): ")) {
-                    bookFound = true;
+                texts.push_back(text);
+                shouted.push_back(upper);
+            }
+            for (size_t set = 0; set < setCount; ++set) {
+                const CaseFoldKernels& kernels = kernelSets[set];
+                string suffix = string(kind) + "_" + kernels.name;
+                size_t matched = 0;
+                Measurement since;
+                for (size_t i = 0; i < repeats; ++i) {
+                    const string& text = texts[i % SAMPLES];
+                    matched += kernels.mismatch(text.data(), shouted[i % SAMPLES].data(), text.length()) == text.length();
+                }
+                report(0, ("compare_" + suffix).c_str(), repeats, since);
+                since = Measurement();
+                for (size_t i = 0; i < repeats; ++i) {
+                    string& text = shouted[i % SAMPLES];
+                    kernels.lowercase(&text[0], text.length());
+                }
+                report(0, ("lowercase_" + suffix).c_str(), repeats, since);
+                if (matched != repeats) {
+                    cerr << "Warning: " << repeats - matched << " case-insensitive comparisons failed.\n";
+                }
+                for (size_t i = 0; i < SAMPLES; ++i) {
+                    for (char& c : shouted[i]) {
+                        c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+                    }
                 }
             }
         }
     }
 
-    void viewBooksByCategory() {
-        string category = getValidCategory();
-        bool found = false;
-
-        cout << "\n--- Books in " << category << " Category ---\n";
-        cout << left 
-             << setw(15) << "ID"
-             << setw(15) << "ISBN"
-             << setw(20) << "Title"
-             << setw(40) << "Authors"
-             << setw(10) << "Edition"
-             << setw(15) << "Publication"
-             << setw(15) << "Category" << endl;
+public:
+    // Constructor
+    CatalogBenchmark() : state(0x9E3779B97F4A7C15ull) {}
 
-        for (int i = 0; i < bookCount; ++i) {
-            if (caseInsensitiveCompare(books[i].getCategory(), category)) {
-                displayBookDetails(books[i]);
-                found = true;
-            }
+    void runUpTo(size_t maxBooks) {
+        runCaseFolding();
+        for (size_t size = 1000; size <= maxBooks; size *= 10) {
+            run(size);
         }
+    }
+};
 
-        if (!found) {
-            cout << "No books found in this category.\n";
+// Checks of batch behaviour that is easy to break without noticing. Each
+// check returns what went wrong, or "" if it passed.
+class SelfTest {
+private:
+    static constexpr const char* NO_FILE = "/dev/null/self-test.dat";
+
+    // Batch replies must keep one record a line even for text with line
+    // breaks, which older catalogs may hold. GET and LIST such books, then
+    // read the records and the cursor back the way a client would.
+    static string checkRecordFraming() {
+        LibraryManagementSystem lms(NO_FILE, true);
+        StringArray authors;
+        authors.push_back("Ann\r\nLee");
+        lms.insertBook(Book("A1", "9780306406157", "Line one\nGET B2", authors, "1st", "2001", "Fiction"));
+        lms.insertBook(Book("A2", "9780306406157", "Line one\nGET B3", authors, "1st", "2001", "Fiction"));
+
+        string out;
+        bool changed = false;
+        lms.runCommand("GET A1", out, changed);
+        if (count(out.begin(), out.end(), '\n') != 1 || out.compare(0, 3, "OK ") != 0) {
+            return "GET reply is not one line";
         }
-        pressAnyContinue();
+        Book book;
+        LibraryManagementSystem::parseRecord(out.substr(3, out.size() - 4), book);
+        if (book.getTitle() != "Line one\nGET B2" || book.getAuthors()[0] != "Ann\r\nLee") {
+            return "GET record does not read back";
+        }
+        out.clear();
+        lms.runCommand("LIST title 1", out, changed);
+        // The cursor is the rest of the line after "OK n first total"
+        size_t cursorStart = 0;
+        for (int field = 0; field < 4; ++field) {
+            cursorStart = out.find(' ', cursorStart) + 1;
+        }
+        string cursor = out.substr(cursorStart, out.find('\n') - cursorStart);
+        out.clear();
+        lms.runCommand("LIST title 1 " + cursor, out, changed);
+        if (count(out.begin(), out.end(), '\n') != 2 || out.find("|Line one\\nGET B3|") == string::npos) {
+            return "LIST cursor does not read back";
+        }
+        return "";
     }
 
-    void viewAllBooks() {
-        if (bookCount == 0) {
-            cout << "No books in the library.\n";
-            pressAnyContinue();
-            return;
+    // New books must not bring line breaks or other control characters in,
+    // even escaped
+    static string checkControlCharacters() {
+        LibraryManagementSystem lms(NO_FILE, true);
+        const char* const records[] = {
+            "ADD C1|9780306406157|Line one\\nLine two|Ann|1st|2001|Fiction",
+            "ADD C2|9780306406157|Title|Ann\\rLee|1st|2001|Fiction",
+            "ADD C3|9780306406157|Tab\there|Ann|1st|2001|Fiction"};
+        for (const char* record : records) {
+            string out;
+            bool changed = false;
+            lms.runCommand(record, out, changed);
+            if (out.compare(0, 4, "ERR ") != 0) {
+                return string("accepted ") + record;
+            }
         }
+        return lms.books.length() == 0 ? "" : "stored a rejected book";
+    }
 
-        cout << "\n--- All Books ---\n";
-        cout << left 
-             << setw(15) << "ID"
-             << setw(15) << "ISBN"
-             << setw(20) << "Title"
-             << setw(40) << "Authors"
-             << setw(10) << "Edition"
-             << setw(15) << "Publication"
-             << setw(15) << "Category" << endl;
-
-        for (int i = 0; i < bookCount; ++i) {
-            displayBookDetails(books[i]);
+public:
+    // Run every check, naming the failures on standard error. Returns
+    // false if any failed.
+    static bool run() {
+        struct Check {
+            const char* name;
+            string (*run)();
+        };
+        const Check checks[] = {{"record framing", checkRecordFraming},
+                                {"control characters", checkControlCharacters}};
+        size_t failed = 0;
+        for (const Check& check : checks) {
+            string problem = check.run();
+            if (!problem.empty()) {
+                cerr << "FAIL " << check.name << ": " << problem << "\n";
+                ++failed;
+            }
         }
-        pressAnyContinue();
+        size_t total = sizeof(checks) / sizeof(checks[0]);
+        cout << total - failed << " of " << total << " checks passed.\n";
+        return failed == 0;
     }
+};
 
-    int getMenuChoice() {
-        string input;
-        bool validChoice = false;
-        int choice = 0;
-        
-        do {
-            cout << "\n--- Library Management System ---\n";
-            cout << "1 - Add Book\n";
-            cout << "2 - Edit Book\n";
-            cout << "3 - Search Book\n";
-            cout << "4 - Delete Book\n";
-            cout << "5 - View Books by Category\n";
-            cout << "6 - View All Books\n";
-            cout << "7 - Exit\n";
-            cout << "Enter your choice (1-7): ";
+void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [--catalog FILE] [--categories FILE] [--batch [FILE]]\n"
+         << "       " << program << " --bench [BOOKS]\n"
+         << "       " << program << " --self-test\n"
+#ifdef LMS_SERVER
+         << "       " << program << " [--catalog FILE] --serve ADDRESS [--threads N]\n"
+         << "       " << program << " --load-test ADDRESS [--clients N] [--window N] [--seconds S]\n"
+#endif
+         << "  --catalog FILE  catalog to open (default library.dat)\n"
+         << "  --categories FILE\n"
+         << "                  use the category taxonomy in FILE, one NAME|PARENT|ALIAS;ALIAS...\n"
+         << "                  a line, instead of Fiction and Non-fiction\n"
+         << "  --batch [FILE]  run commands from FILE, or standard input, instead of the menu\n"
+         << "  --bench [BOOKS] time catalog operations on generated catalogs of 1000 books\n"
+         << "                  up to BOOKS (default 1000000), one key=value line per result;\n"
+         << "                  builds with LMS_BENCH defined also count allocations\n"
+         << "  --self-test     check batch record handling; exits with 1 if a check fails\n"
+#ifdef LMS_SERVER
+         << "  --serve ADDRESS answer batch commands from clients on ADDRESS, either\n"
+         << "                  unix:PATH or [HOST:]PORT, until interrupted\n"
+         << "  --threads N     workers running commands (default one per core)\n"
+         << "  --load-test ADDRESS\n"
+         << "                  measure a server with N clients (default 8), each keeping\n"
+         << "                  a window of N GET requests (default 16) in flight for S\n"
+         << "                  seconds (default 5)\n"
+#endif
+         ;
+}
 
-            getline(cin, input);
-            
-            // Manual validation 
-            if (input.length() == 1 && input[0] >= '1' && input[0] <= '7') {
-                choice = input[0] - '0';
-                validChoice = true;
-            } else {
-                cout << "Invalid choice! Please enter a single digit between 1 and 7.\n";
+int main(int argc, char* argv[]) {
+    string catalogPath = "library.dat";
+    string categoriesPath;
+    bool batch = false;
+    string batchPath = "-";
+    size_t benchBooks = 0;
+    bool selfTest = false;
+#ifdef LMS_SERVER
+    string serveAddress;
+    string loadAddress;
+    size_t threads = max(1u, thread::hardware_concurrency());
+    size_t clients = 8;
+    size_t window = 16;
+    double seconds = 5;
+#endif
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+#ifdef LMS_SERVER
+        bool counted = i + 1 < argc && atoi(argv[i + 1]) > 0;
+#endif
+        if (arg == "--catalog" && i + 1 < argc) {
+            catalogPath = argv[++i];
+        } else if (arg == "--categories" && i + 1 < argc) {
+            categoriesPath = argv[++i];
+#ifdef LMS_SERVER
+        } else if (arg == "--serve" && i + 1 < argc) {
+            serveAddress = argv[++i];
+        } else if (arg == "--load-test" && i + 1 < argc) {
+            loadAddress = argv[++i];
+        } else if (arg == "--threads" && counted) {
+            threads = static_cast<size_t>(atoi(argv[++i]));
+        } else if (arg == "--clients" && counted) {
+            clients = static_cast<size_t>(atoi(argv[++i]));
+        } else if (arg == "--window" && counted) {
+            window = static_cast<size_t>(atoi(argv[++i]));
+        } else if (arg == "--seconds" && i + 1 < argc && atof(argv[i + 1]) > 0) {
+            seconds = atof(argv[++i]);
+#endif
+        } else if (arg == "--bench") {
+            benchBooks = 1000000;
+            if (i + 1 < argc && atol(argv[i + 1]) >= 1000) {
+                benchBooks = static_cast<size_t>(atol(argv[++i]));
             }
-        } while (!validChoice);
-        
-        return choice;
+        } else if (arg == "--self-test") {
+            selfTest = true;
+        } else if (arg == "--batch") {
+            batch = true;
+            if (i + 1 < argc && (argv[i + 1][0] != '-' || strcmp(argv[i + 1], "-") == 0)) {
+                batchPath = argv[++i];
+            }
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
     }
 
-    void run() {
-        bool running = true;
-        
-        while (running) {
-            int choice = getMenuChoice();
+    if (!categoriesPath.empty()) {
+        MappedFile file;
+        string error;
+        if (!file.open(categoriesPath)) {
+            cerr << "Could not open " << categoriesPath << ".\n";
+            return 1;
+        }
+        if (!bookCategories.load(string_view(file.data(), file.length()), error)) {
+            cerr << "Could not load categories from " << categoriesPath << ": " << error << ".\n";
+            return 1;
+        }
+    }
 
-            switch (choice) {
-                case 1: addBook(); break;
-                case 2: editBook(); break;
-                case 3: searchBook(); break;
-                case 4: deleteBook(); break;
-                case 5: viewBooksByCategory(); break;
-                case 6: viewAllBooks(); break;
-                case 7: 
-                    cout << "Exiting Library Management System...\n";
-                    running = false;
-                    break;
-            }
+    if (selfTest) {
+        return SelfTest::run() ? 0 : 1;
+    }
+    if (benchBooks > 0) {
+        CatalogBenchmark benchmark;
+        benchmark.runUpTo(benchBooks);
+        return 0;
+    }
+
+#ifdef LMS_SERVER
+    if (!loadAddress.empty()) {
+        return LoadGenerator::run(loadAddress, clients, window, seconds) ? 0 : 1;
+    }
+    if (!serveAddress.empty()) {
+        LibraryManagementSystem lms(catalogPath);
+        CatalogServer server(lms, catalogPath);
+        string error;
+        if (!server.listenOn(serveAddress, error)) {
+            cerr << "Could not listen on " << error << ".\n";
+            return 1;
         }
+        cerr << "Serving " << catalogPath << " on " << serveAddress << " with " << threads << " workers.\n";
+        bool saved = server.serve(threads);
+        return lms.saveCatalog() && saved ? 0 : 1;
+    }
+#endif
+
+    if (!batch) {
+        LibraryManagementSystem lms(catalogPath);
+        lms.run();
+        return 0;
     }
-};
 
-int main() {
-    LibraryManagementSystem lms;
-    lms.run();
-    return 0;
+    FILE* input = batchPath == "-" ? stdin : fopen(batchPath.c_str(), "rb");
+    if (input == nullptr) {
+        cerr << "Could not open " << batchPath << ".\n";
+        return 1;
+    }
+    // Results go to standard output; the catalog's own messages go to standard error
+    streambuf* console = cout.rdbuf(cerr.rdbuf());
+    bool saved;
+    {
+        LibraryManagementSystem lms(catalogPath);
+        saved = lms.runBatch(input);
+    }
+    cout.rdbuf(console);
+    if (input != stdin) {
+        fclose(input);
+    }
+    return saved ? 0 : 1;
 }